@@ -1,6 +1,6 @@
 /**********************************************************
 ChromData.cpp
-Last modified: 05/22/2024
+Last modified: 10/16/2026
 ***********************************************************/
 
 #include "ChromData.h"
@@ -8,6 +8,8 @@ Last modified: 05/22/2024
 #include <fstream>		// to write ChromSizes without defined _TXT_WRITER
 
 
+thrid ChromSizes::ThrCnt = 1;	// number of threads for generating chrom sizes
+
 inline int ChromSizes::CommonPrefixLength(const string& fName, BYTE extLen)
 {
 	// a short file name without extention
@@ -98,8 +100,21 @@ ChromSizes::ChromSizes(const char* gName, bool prMsg, const char* sPath, bool ch
 
 			if (isExist)	Read(cName);
 			else {							// generate chrom.sizes
-				for (chrid cid : cIDs)
-					AddValue(cid, ChromSize(FaReader(RefName(cid) + _ext).ChromLength()));
+				vector<chrlen> lens(cIDs.size());
+				auto getLen = [&](size_t i) {
+					const string fName = RefName(cIDs[i]) + _ext;
+					const FaIndex fai(fName, IsServAvail() ? ServName(cIDs[i]) + _ext + FaIndex::Ext : strEmpty, false);
+
+					lens[i] = fai.IsValid() ? fai.Length() : FaReader(fName).ChromLength();
+				};
+#ifdef _MULTITHREAD
+				// rethrows reading error
+				WorkerPool(thrid(min(size_t(ThrCnt), cIDs.size()))).Run(cIDs.size(), getLen);
+#else
+				for (size_t i = 0; i < cIDs.size(); i++)	getLen(i);
+#endif
+				for (size_t i = 0; i < cIDs.size(); i++)
+					AddValue(cIDs[i], ChromSize(lens[i]));
 				if (IsServAvail())	Write(cName);
 				if (prMsg)
 					dout << FS::ShortFileName(cName) << SPACE << (IsServAvail() ? "created" : "generated") << LF,
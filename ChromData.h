@@ -230,6 +230,8 @@ protected:
 	chrlen Length(cIter it) const { return Data(it).Real; }
 
 public:
+	static thrid ThrCnt;	// number of threads for generating chrom sizes; 1 for serial generating
+
 	const string& RefExt() const { return _ext; }
 
 	// Creates and initializes an instance.
@@ -1,47 +1,314 @@
 /**********************************************************
 ChromSeq.cpp  2023 Fedor Naumenko (fedor.naumenko@gmail.com)
-Last modified: 05/22/2024
+Last modified: 10/16/2026
 ***********************************************************/
 #include "ChromSeq.h"
+#include <array>
+#include <algorithm>	// upper_bound
+#ifdef __unix__
+#include <sys/mman.h>	// mmap()
+#endif
 
 bool ChromSeq::LetGaps = true;	// if true then include gaps at the edges of the ref chrom while reading
 bool ChromSeq::StatGaps = false;	// if true sum gaps for statistic output
+const string ChromSeq::CacheExt = ".nts";	// binary cache file extension
+
+// 2-bit codes of nucleotides; 4 for undefined ones
+static const auto NtCodes = [] {
+	array<BYTE, 256> codes;
+	codes.fill(4);
+	codes['A'] = codes['a'] = 0;
+	codes['C'] = codes['c'] = 1;
+	codes['G'] = codes['g'] = 2;
+	codes['T'] = codes['t'] = 3;
+	return codes;
+}();
+
+// Returns length of packed nucleotides
+//	@param len: number of nucleotides
+inline size_t PackedLen(chrlen len) { return (size_t(len) + 3) >> 2; }
+
+// unpacked nucleotides for each packed byte
+static const auto NtUnpacked = [] {
+	array<array<char, 4>, 256> nts;
+	for (int b = 0; b < 256; b++)
+		for (BYTE i = 0; i < 4; i++)
+			nts[b][i] = "ACGT"[b >> (i << 1) & 3];
+	return nts;
+}();
+
+void ChromSeq::Pack(const char* line, chrlen pos, chrlen len)
+{
+	for (const chrlen end = pos + len; pos < end; pos++) {
+		BYTE code = NtCodes[BYTE(*line++)];
+		if (code > 3) {
+			if (_nRuns.size() && _nRuns.back().End == pos)	_nRuns.back().End++;
+			else	_nRuns.emplace_back(pos, pos + 1);
+			code = 0;
+		}
+		_packed[pos >> 2] |= code << ((pos & 3) << 1);
+	}
+}
 
 bool ChromSeq::Init(const string& fName, ChromDefRegions& rgns, bool fill)
 {
-	_seq = nullptr;
 	bool getN = StatGaps || LetGaps || rgns.Empty();	// if true then chrom def regions should be recorded
 	FaReader file(fName, rgns.Empty() ? &rgns : nullptr);
 
 	_len = file.ChromLength();
 	if (fill) {
-		try { _seq = new char[_len]; }
+		try { _packed.assign(PackedLen(_len), 0); }
 		catch (const bad_alloc&) { Err(Err::F_MEM, fName.c_str()).Throw(); }
 		const char* line = file.Line();		// First line is readed by FaReader()
 		chrlen lineLen;
 		_len = 0;
 
-		do	memcpy(_seq + _len, line, lineLen = file.LineLength()),
+		do	Pack(line, _len, lineLen = file.LineLength()),
 			_len += lineLen;
 		while (line = file.NextGetLine());
+		_seq = _packed.data();
+		_nRuns.shrink_to_fit();
 	}
 	else if (getN)	while (file.NextGetLine());	// just to fill chrom def regions
 	file.CLoseReading();	// only makes sense if chrom def regions were filled
 	return getN;
 }
 
+char* ChromSeq::Seq(chrlen pos, chrlen len, char* dst) const
+{
+	const chrlen end = pos + len;
+	char* nts = dst;
+
+	// unpack nucleotides: unaligned head, whole bytes, tail
+	for (; pos < end && pos & 3; pos++)
+		*nts++ = NtUnpacked[_seq[pos >> 2]][pos & 3];
+	for (; pos + 4 <= end; pos += 4, nts += 4)
+		memcpy(nts, NtUnpacked[_seq[pos >> 2]].data(), 4);
+	for (; pos < end; pos++)
+		*nts++ = NtUnpacked[_seq[pos >> 2]][pos & 3];
+
+	// apply undefined nucleotides
+	pos = end - len;
+	for (auto it = upper_bound(_nRuns.begin(), _nRuns.end(), pos,
+		[](chrlen p, const Region& rgn) { return p < rgn.End; });
+		it != _nRuns.end() && it->Start < end; it++) {
+		const chrlen start = max(it->Start, pos);
+		memset(dst + start - pos, cN, min(it->End, end) - start);
+	}
+	return dst;
+}
+
+const char* ChromSeq::Seq(chrlen pos) const
+{
+	auto unpack = [this] {
+		_unpacked.reset(new char[_len]);
+		Seq(0, _len, _unpacked.get());
+	};
+#ifdef _MULTITHREAD
+	call_once(_unpackFlag, unpack);
+#else
+	if (!_unpacked)	unpack();
+#endif
+	return _unpacked.get() + pos;
+}
+
+// Binary cache layout: header, undefined nucleotides runs, packed nucleotides
+struct CacheHeader
+{
+	char	Magic[4];
+	chrlen	Len;			// chrom length
+	chrlen	GapLen;			// total length of gaps
+	chrlen	DefStart;		// defined region start
+	chrlen	DefEnd;			// defined region end
+	chrlen	RunsCnt;		// number of undefined nucleotides runs
+	uint64_t SrcSize;		// FA file size
+	int64_t	SrcTime;		// FA file modification time
+};
+
+static const char CacheMagic[] = { 'N','T','S','1' };
+
+bool ChromSeq::LoadCache(const string& cName, const string& fName, Region& defRgn)
+{
+	struct_stat64 st, cst;
+	CacheHeader h;
+
+	if (_stat64(fName.c_str(), &st) || _stat64(cName.c_str(), &cst))	return false;
+	FILE* file = fopen(cName.c_str(), "rb");
+	if (!file)	return false;
+	bool res = fread(&h, sizeof h, 1, file) == 1
+		&& !memcmp(h.Magic, CacheMagic, sizeof CacheMagic)
+		&& h.SrcSize == uint64_t(st.st_size) && h.SrcTime == int64_t(st.st_mtime);
+	const size_t offset = sizeof h + (res ? h.RunsCnt : 0) * sizeof(Region);
+
+	if (res && uint64_t(cst.st_size) == offset + PackedLen(h.Len)) {
+		_nRuns.resize(h.RunsCnt);
+		res = fread((void*)_nRuns.data(), sizeof(Region), h.RunsCnt, file) == h.RunsCnt;
+		if (res) {
+#ifdef __unix__
+			_mapLen = offset + PackedLen(h.Len);
+			_map = mmap(nullptr, _mapLen, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+			if (_map == MAP_FAILED)	_map = nullptr, res = false;
+			else	_seq = (const BYTE*)_map + offset;
+#else
+			_packed.resize(PackedLen(h.Len));
+			res = fread(_packed.data(), 1, _packed.size(), file) == _packed.size();
+			_seq = _packed.data();
+#endif
+		}
+	}
+	else res = false;
+	fclose(file);
+
+	if (res) {
+		_len = h.Len;
+		_gapLen = h.GapLen;
+		defRgn.Set(h.DefStart, h.DefEnd);
+	}
+	else _nRuns.clear();
+	return res;
+}
+
+void ChromSeq::SaveCache(const string& cName, const string& fName, const Region& defRgn) const
+{
+	struct_stat64 st;
+
+	if (_stat64(fName.c_str(), &st))	return;
+	CacheHeader h{ {}, _len, _gapLen, defRgn.Start, defRgn.End, chrlen(_nRuns.size()),
+		uint64_t(st.st_size), int64_t(st.st_mtime) };
+	memcpy(h.Magic, CacheMagic, sizeof CacheMagic);
+
+	// write to the temporary file to avoid reading of the incomplete cache by a concurrent run
+	const string tmpName = cName + ".tmp";
+	FILE* file = fopen(tmpName.c_str(), "wb");
+	if (!file)	return;
+	const bool res = fwrite(&h, sizeof h, 1, file) == 1
+		&& fwrite(_nRuns.data(), sizeof(Region), _nRuns.size(), file) == _nRuns.size()
+		&& fwrite(_seq, 1, PackedLen(_len), file) == PackedLen(_len);
+	if (fclose(file) || !res || (remove(cName.c_str()), rename(tmpName.c_str(), cName.c_str())))
+		remove(tmpName.c_str());
+}
+
 ChromSeq::ChromSeq(chrid cID, const ChromSizes& cSizes)
 {
 	_ID = cID;
 	ChromDefRegions rgns(cSizes.ServName(cID));	// read from file or new (empty)
+	const string fName = cSizes.RefName(cID) + cSizes.RefExt();
+	const string cName = cSizes.ServName(cID) + CacheExt;
+	const bool getN = StatGaps || LetGaps || rgns.Empty();
+	const bool useCache = cSizes.ServPath().size();	// no cache without service directory
+	Region defRgn;
 
-	if (Init(cSizes.RefName(cID) + cSizes.RefExt(), rgns, true) && !rgns.Empty())
+	if (useCache && LoadCache(cName, fName, defRgn)) {
+		if (getN)	_effDefRgn.Set(defRgn.Start, defRgn.End);
+		else		_effDefRgn.Set(0, Length());
+		return;
+	}
+	if (Init(fName, rgns, true) && !rgns.Empty())
 		_effDefRgn.Set(rgns.FirstStart(), rgns.LastEnd());
 	else
 		_effDefRgn.Set(0, Length());
 	_gapLen = rgns.GapLen();
+	if (useCache)
+		SaveCache(cName, fName, rgns.Count() ? Region(rgns.FirstStart(), rgns.LastEnd()) : Region(0, Length()));
+}
+
+char* ChromSeq::Fetch(chrid cID, const ChromSizes& cSizes, const Region& rgn, char* dst)
+{
+	const string fName = cSizes.RefName(cID) + cSizes.RefExt();
+
+	if (rgn.Invalid())	return dst;
+	if (rgn.End > cSizes[cID])	Err("region exceeds the chrom length", fName).Throw();
+
+	const FaIndex fai(fName, cSizes.ServPath().size() ? cSizes.ServName(cID) + cSizes.RefExt() + FaIndex::Ext : strEmpty);
+	if (!fai.IsValid())		// compressed FA file
+		return ChromSeq(cID, cSizes).Seq(rgn.Start, rgn.Length(), dst);
+	fai.Fetch(rgn, dst);
+	// the same as packing and unpacking: upper case, any ambiguous nucleotide as 'N'
+	transform(dst, dst + rgn.Length(), dst, [](char c) {
+		const BYTE code = NtCodes[BYTE(c)];
+		return code < 4 ? "ACGT"[code] : cN;
+	});
+	return dst;
+}
+
+ChromSeq::~ChromSeq()
+{
+#ifdef __unix__
+	if (_map)	munmap(_map, _mapLen);
+#endif
 }
 
+#ifdef _MULTITHREAD
+/************************ ChromSeqLoader ************************/
+
+size_t ChromSeqLoader::MemSize(size_t i) const { return PackedLen(_cSizes[_cIDs[i]]); }
+
+void ChromSeqLoader::Work()
+{
+	for (;;) {
+		size_t i;
+		{
+			unique_lock<mutex> lock(_mutex);
+			if (_stop || _nextLoad == _cIDs.size())	return;
+			i = _nextLoad++;
+			const size_t mem = MemSize(i);
+			// the sequence awaited by the consumer is loaded regardless of the budget to avoid deadlock
+			_freed.wait(lock, [&] { return _stop || i == _nextTake || _memUsed + mem <= _budget; });
+			if (_stop)	return;
+			_memUsed += mem;
+		}
+		unique_ptr<ChromSeq> seq;
+		exception_ptr err;
+		try { seq.reset(new ChromSeq(_cIDs[i], _cSizes)); }
+		catch (...) { err = current_exception(); }
+		{
+			lock_guard<mutex> lock(_mutex);
+			_seqs[i] = move(seq);
+			_errs[i] = err;
+		}
+		_loaded.notify_all();
+	}
+}
+
+ChromSeqLoader::ChromSeqLoader(const ChromSizes& cSizes, thrid thrCnt, size_t memBudget)
+	: _cSizes(cSizes), _budget(memBudget)
+{
+	for (auto it = cSizes.begin(); it != cSizes.end(); it++)
+		if (cSizes.IsTreated(it))	_cIDs.push_back(it->first);
+	_seqs.resize(_cIDs.size());
+	_errs.resize(_cIDs.size());
+	thrCnt = thrid(min(size_t(max(thrCnt, thrid(1))), _cIDs.size()));
+	for (thrid i = 0; i < thrCnt; i++)
+		_workers.emplace_back(&ChromSeqLoader::Work, this);
+}
+
+ChromSeqLoader::~ChromSeqLoader()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_freed.notify_all();
+	for (auto& w : _workers)	w.join();
+}
+
+unique_ptr<ChromSeq> ChromSeqLoader::Next()
+{
+	unique_lock<mutex> lock(_mutex);
+	if (_nextTake == _cIDs.size())	return nullptr;
+
+	const size_t i = _nextTake;
+	_loaded.wait(lock, [&] { return _seqs[i] || _errs[i]; });
+	_nextTake++;
+	_memUsed -= MemSize(i);
+	_freed.notify_all();
+	if (_errs[i])	rethrow_exception(_errs[i]);
+	return move(_seqs[i]);
+}
+
+/************************ ChromSeqLoader: end ************************/
+#endif	// _MULTITHREAD
+
 #if defined _READDENS || defined _BIOCC
 
 ChromSeq::ChromSeq(const string& fName, ChromDefRegions& rgns, short minGapLen)
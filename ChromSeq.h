@@ -1,12 +1,18 @@
 /**********************************************************
 ChromSeq.h  2023 Fedor Naumenko (fedor.naumenko@gmail.com)
-Last modified: 05/22/2024
+Last modified: 10/16/2026
 ***********************************************************/
 #pragma once
 
 #include "ChromData.h"
+#ifdef _MULTITHREAD
+#include <condition_variable>
+#endif
 
-// 'ChromSeq' represented chromosome as an array of nucleotides
+// 'ChromSeq' represented chromosome as an array of nucleotides.
+//	Nucleotides are kept packed, so they are unpacked on demand by Seq(pos, len, dst), always in upper case;
+//	the original letter case (soft-masked repeats) is not kept.
+//	Former Seq(pos) returning pointer to the nucleotides is kept as deprecated.
 class ChromSeq
 {
 private:
@@ -14,7 +20,23 @@ private:
 	chrlen	_len;			// length of chromosome
 	chrlen	_gapLen = 0;	// total length of gaps
 	Region	_effDefRgn;		// effective defined region (except 'N' at the begining and at the end)
-	char* _seq = nullptr;	// the nucleotides buffer
+	const BYTE* _seq = nullptr;	// nucleotides packed by 4 per byte, 2 bits per nucleotide
+	vector<BYTE> _packed;	// packed nucleotides buffer, if they are not mapped from the cache
+	vector<Region> _nRuns;	// runs of undefined nucleotides ('N' or any ambiguous), sorted
+	mutable unique_ptr<char[]> _unpacked;	// whole unpacked sequence for deprecated Seq(pos)
+#ifdef _MULTITHREAD
+	mutable once_flag _unpackFlag;
+#endif
+#ifdef __unix__
+	void*	_map = nullptr;	// mapped cache
+	size_t	_mapLen = 0;	// length of mapped cache
+#endif
+
+	// Packs nucleotides and adds undefined ones to the runs
+	//	@param line: nucleotides
+	//	@param pos: position of the first nucleotide
+	//	@param len: number of nucleotides
+	void Pack(const char* line, chrlen pos, chrlen len);
 
 	// Initializes instance and/or chrom's defined regions
 	//	@param fName: file name
@@ -23,11 +45,27 @@ private:
 	//	@returns: true if chrom def regions are stated
 	bool Init(const string& fName, ChromDefRegions& rgns, bool fill);
 
+	// Initializes instance from the cache if it is actual
+	//	@param cName: cache file name
+	//	@param fName: FA file name
+	//	@param defRgn: returned defined region
+	//	@returns: true if instance is initialized
+	bool LoadCache(const string& cName, const string& fName, Region& defRgn);
+
+	// Saves instance to the cache; the failure is ignored
+	//	@param cName: cache file name
+	//	@param fName: FA file name
+	//	@param defRgn: defined region
+	void SaveCache(const string& cName, const string& fName, const Region& defRgn) const;
+
 public:
 	static bool	LetGaps;	// if true then include gaps at the edges of the ref chrom while reading
 	static bool	StatGaps;	// if true count sum gaps for statistic output
+	static const string CacheExt;	// binary cache file extension
+
+	ChromSeq(const ChromSeq&) = delete;
 
-	~ChromSeq() { if(_seq)	delete[] _seq; }
+	~ChromSeq();
 
 	// Gets chrom legth
 	chrlen Length()	const { return _len; }
@@ -37,16 +75,36 @@ public:
 
 	//const char* Read(chrlen pos, readlen len) const { return pos + len > Length() ? NULL : _seq + pos; }
 
-	// Gets subsequence without exceeding checking 
-	const char* Seq(chrlen pos) const { return _seq + pos; }
+	// Unpacks subsequence in upper case without exceeding checking; thread-safe
+	//	@param pos: start position
+	//	@param len: subsequence length
+	//	@param dst: destination buffer of len chars at least
+	//	@returns: dst
+	char* Seq(chrlen pos, chrlen len, char* dst) const;
+
+	// Returns pointer to the nucleotides in upper case starting from position.
+	//	Unpacks the whole chrom on the first call, which takes 1 byte per nucleotide in addition.
+	//	@param pos: start position
+	[[deprecated("use Seq(pos, len, dst)")]]
+	const char* Seq(chrlen pos) const;
 
 	// Creates a stub instance (for sampling cutting)
 	//	@param len: chrom length
-	ChromSeq(chrlen len) : _ID(Chrom::UnID), _seq(NULL), _len(len) { _effDefRgn.Set(0, len); }
+	ChromSeq(chrlen len) : _ID(Chrom::UnID), _len(len) { _effDefRgn.Set(0, len); }
 
 	// Creates and fills new instance
 	ChromSeq(chrid cID, const ChromSizes& cSizes);
 
+	// Reads region nucleotides in upper case, with any ambiguous nucleotide as 'N', without loading the whole chrom.
+	//	Uncompressed FA file is read directly by its index, which is built and saved in the service directory if absent,
+	//	otherwise the chrom is loaded.
+	//	@param cID: chrom ID
+	//	@param cSizes: chrom sizes
+	//	@param rgn: region within the chrom
+	//	@param dst: destination buffer of rgn.Length() chars at least
+	//	@returns: dst
+	static char* Fetch(chrid cID, const ChromSizes& cSizes, const Region& rgn, char* dst);
+
 	// Returns chrom ID
 	chrid ID() const { return _ID; }
 
@@ -81,4 +139,45 @@ public:
 //	// Saves instance to file by fname
 //	void Write(const string & fname, const char *chrName) const;
 //#endif
-};
\ No newline at end of file
+};
+
+#ifdef _MULTITHREAD
+// 'ChromSeqLoader' reads and gap-scans chromosome sequences concurrently, and returns them in chromosome order.
+//	The total size of loaded but not yet taken sequences is bounded by the memory budget.
+class ChromSeqLoader
+{
+	const ChromSizes& _cSizes;
+	vector<chrid>	_cIDs;					// IDs of loaded chromosomes
+	vector<unique_ptr<ChromSeq>> _seqs;		// loaded but not yet taken sequences
+	vector<exception_ptr> _errs;			// loading exceptions
+	vector<thread>	_workers;
+	mutex			_mutex;
+	condition_variable _loaded;				// signals that the sequence is loaded
+	condition_variable _freed;				// signals that the memory is freed or loading is stopped
+	const size_t	_budget;				// memory budget in bytes
+	size_t	_memUsed = 0;					// memory of loading and loaded but not yet taken sequences
+	size_t	_nextLoad = 0;					// index of the next sequence to load
+	size_t	_nextTake = 0;					// index of the next sequence to take
+	bool	_stop = false;					// true if loading should be stopped
+
+	// Returns estimated memory of the sequence
+	//	@param i: sequence index
+	size_t MemSize(size_t i) const;
+
+	// Loads sequences in the order of their indices
+	void Work();
+
+public:
+	// Creates instance and launches loading
+	//	@param cSizes: chrom sizes; all treated chromosomes are loaded
+	//	@param thrCnt: number of loading threads
+	//	@param memBudget: memory budget in bytes; the sequence awaited by Next() is loaded anyway
+	ChromSeqLoader(const ChromSizes& cSizes, thrid thrCnt, size_t memBudget);
+
+	~ChromSeqLoader();
+
+	// Returns the next loaded sequence in chromosome order, or nullptr after the last one;
+	//	rethrows the loading exception
+	unique_ptr<ChromSeq> Next();
+};
+#endif	// _MULTITHREAD
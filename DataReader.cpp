@@ -1,10 +1,12 @@
 /**********************************************************
 DataReader.cpp
-Last modified: 07/29/2024
+Last modified: 10/16/2026
 ***********************************************************/
 
 #include "DataReader.h"
 #include "ChromData.h"
+#include <assert.h>
+#include <fstream>		// to read/write sidecar index
 
 /************************ DataReader ************************/
 
@@ -119,8 +121,421 @@ bool BedReader::GetNextChrom(chrid& cID)
 	return SetNextChrom(cID = Chrom::ValidateID(ChromMark()));
 }
 
+bool BedReader::JumpToChrom(chrid cID, bool build)
+{
+	if ((Type() != FT::BED && Type() != FT::ABED && Type() != FT::BGRAPH)
+		|| (IsZipped() && !IsFlag(BGZF)))		// plain gzip does not allow random access
+		return false;
+
+	BedIndex index;
+	uint64_t pos;
+
+	if (!index.Load(FileName(), IsFlag(BGZF))) {
+		if (!build)	return false;
+		try { BedIndex::Build(FileName()); }
+		catch (const Err& err) {		// unsorted or invalid file is read serially
+			Err(err.what()).Throw(false);
+			return false;
+		}
+		if (!index.Load(FileName(), IsFlag(BGZF)))	return false;
+	}
+	if (index.Find(cID, pos)) {
+		if (!SeekTo(size_t(pos)))	ThrowExcept(Err::F_READ);
+		memset(_chrMark, 0, sizeof _chrMark);	// to recognize the chrom again
+	}
+	else RaiseFlag(ENDREAD);
+	return true;
+}
+
 /************************ end of BedReader ************************/
 
+/************************ BedIndex ************************/
+
+const char* BedIndex::TbiExt = ".tbi";
+const char* BedIndex::CixExt = ".cix";
+
+const BYTE	TbiMinShift = 14;		// tabix minimal bin size: 16 kb
+const BYTE	TbiLevels = 5;			// tabix number of binning levels
+const uint32_t TbiMetaBin = 37450;	// tabix pseudo-bin holding metadata
+
+// Returns tabix bin of region [beg, end)
+uint32_t TbiReg2Bin(int64_t beg, int64_t end)
+{
+	int l = TbiLevels, s = TbiMinShift, t = ((1 << TbiLevels * 3) - 1) / 7;
+
+	for (--end; l > 0; --l, s += 3, t -= 1 << l * 3)
+		if (beg >> s == end >> s)	return uint32_t(t + (beg >> s));
+	return 0;
+}
+
+void BedIndex::Build(const string& fName)
+{
+	struct Chunk { uint64_t Beg, End; };	// virtual offsets of the first line and after the last line
+	struct Ref {
+		string	Name;
+		uint64_t Start;							// offset of the first line
+		map<uint32_t, vector<Chunk>> Bins;
+		vector<uint64_t> Windows;				// linear index: offsets of the first lines overlapping 16 kb windows
+
+		Ref(const string& name, uint64_t start) : Name(name), Start(start) {}
+	};
+	const uint32_t chunkLen = 0x10000;			// length of the reading chunk of uncompressed file
+
+	FILE* file = fopen(fName.c_str(), "rb");
+	if (!file)	Err(Err::F_OPEN, fName.c_str()).Throw();
+
+	vector<Ref> refs;
+	string line, data, errMsg;
+	uint64_t addr, lineOff = 0;
+	int32_t skip = 0;			// number of header lines
+	bool newLine = true;
+#ifdef _ZLIB
+	char header[18]{};			// BGZF member header
+	unique_ptr<BgzfReader> bgzf(fread(header, 1, sizeof header, file) == sizeof header
+		&& BgzfReader::IsBgzf(header) ? new BgzfReader(file) : nullptr);
+	rewind(file);
+#else
+	const unique_ptr<int> bgzf;	// never set
+#endif
+	auto offset = [&bgzf](uint64_t addr, size_t i) { return bgzf ? addr << 16 | i : addr + i; };
+
+	// adds the line to the index; sets errMsg if the line is invalid or unsorted
+	auto addLine = [&](uint64_t endOff) {
+		if (line.empty())	return;
+		if (refs.empty()
+			&& (line[0] == '#' || !line.compare(0, 5, "track") || !line.compare(0, 7, "browser"))) {
+			skip++;
+			return;
+		}
+		const size_t tab = line.find(TAB);
+		if (tab == string::npos)	{ errMsg = "absent field"; return; }
+		char* last;
+		const int64_t beg = strtoll(line.c_str() + tab + 1, &last, 10);
+		const int64_t end = strtoll(last, &last, 10);
+		if (end <= beg || beg < 0)	{ errMsg = "invalid position"; return; }
+
+		if (refs.empty() || line.compare(0, tab, refs.back().Name)) {
+			const string name(line, 0, tab);
+			for (const Ref& ref : refs)
+				if (ref.Name == name)	{ errMsg = "unsorted chromosome " + name; return; }
+			refs.emplace_back(name, lineOff);
+		}
+		Ref& ref = refs.back();
+		auto& chunks = ref.Bins[TbiReg2Bin(beg, end)];
+		if (chunks.size() && chunks.back().End == lineOff)
+			chunks.back().End = endOff;
+		else
+			chunks.push_back({ lineOff, endOff });
+		const size_t lastWin = size_t((end - 1) >> TbiMinShift);
+		if (ref.Windows.size() <= lastWin)
+			ref.Windows.resize(lastWin + 1, 0);
+		for (size_t w = size_t(beg >> TbiMinShift); w <= lastWin; w++)
+			if (!ref.Windows[w])	ref.Windows[w] = lineOff;
+	};
+
+	// ** scan the file
+	for (int res; errMsg.empty(); ) {
+#ifdef _ZLIB
+		if (bgzf)	res = bgzf->ReadNextBlock(data, addr);
+		else
+#endif
+		{
+			addr = _ftelli64(file);
+			data.resize(chunkLen);
+			data.resize(fread(data.data(), 1, chunkLen, file));
+			res = data.size() ? 1 : ferror(file) ? -1 : 0;
+		}
+		if (res < 0)	errMsg = "could not read";
+		if (res <= 0)	break;
+		for (size_t i = 0; i < data.size() && errMsg.empty(); ) {
+			if (newLine)	lineOff = offset(addr, i), line.clear(), newLine = false;
+			const char* eol = (const char*)memchr(data.data() + i, LF, data.size() - i);
+			const size_t len = eol ? eol - data.data() - i : data.size() - i;
+			line.append(data, i, len);
+			i += len;
+			if (eol) {
+				if (line.size() && line.back() == CR)	line.pop_back();
+				newLine = true;
+				addLine(offset(addr, ++i));
+			}
+		}
+	}
+	if (errMsg.empty() && !newLine)		// last line without LF
+		addLine(offset(addr, data.size()));
+	fclose(file);
+	if (errMsg.size())	Err(errMsg, fName).Throw();
+
+	for (Ref& ref : refs)		// fill gaps in the linear index
+		for (size_t w = 1; w < ref.Windows.size(); w++)
+			if (!ref.Windows[w])	ref.Windows[w] = ref.Windows[w - 1];
+
+	// ** save index
+#ifdef _ZLIB
+	if (bgzf) {
+		string idx("TBI\1");
+		auto put = [&idx](auto val) { idx.append((const char*)&val, sizeof val); };
+		int32_t namesLen = 0;
+
+		for (const Ref& ref : refs)	namesLen += int32_t(ref.Name.size() + 1);
+		put(int32_t(refs.size()));
+		put(int32_t(0x10000));		// format: generic, 0-based half-open positions (UCSC)
+		put(int32_t(1));			// column of chrom name
+		put(int32_t(2));			// column of start
+		put(int32_t(3));			// column of end
+		put(int32_t('#'));			// comment char
+		put(skip);
+		put(namesLen);
+		for (const Ref& ref : refs)	idx.append(ref.Name.c_str(), ref.Name.size() + 1);
+		for (const Ref& ref : refs) {
+			put(int32_t(ref.Bins.size()));
+			for (const auto& bin : ref.Bins) {
+				put(bin.first);
+				put(int32_t(bin.second.size()));
+				for (const Chunk& chunk : bin.second)	put(chunk.Beg), put(chunk.End);
+			}
+			put(int32_t(ref.Windows.size()));
+			for (uint64_t off : ref.Windows)	put(off);
+		}
+
+		const string iName = fName + TbiExt;
+		file = fopen(iName.c_str(), "wb");
+		if (!file)	Err(Err::F_OPEN, iName.c_str()).Throw();
+		BgzfWriter writer(file);
+		const bool written = writer.Write(idx.data(), idx.size()) == idx.size();
+		if (writer.Close() || !written)		// the file is closed anyway
+			Err(Err::F_WRITE, iName.c_str()).Throw();
+	}
+	else
+#endif
+	{
+		const string iName = fName + CixExt;
+		ofstream idx(iName);
+		for (const Ref& ref : refs)	idx << ref.Name << TAB << ref.Start << LF;
+		if (!idx.good())	Err(Err::F_WRITE, iName.c_str()).Throw();
+	}
+}
+
+bool BedIndex::Load(const string& fName, bool bgzf)
+{
+	const string iName = fName + (bgzf ? TbiExt : CixExt);
+	struct_stat64 st, ist;
+
+	if (_stat64(iName.c_str(), &ist) || _stat64(fName.c_str(), &st) || ist.st_mtime < st.st_mtime)
+		return false;
+	_starts.clear();
+#ifdef _ZLIB
+	if (bgzf) {
+		FILE* file = fopen(iName.c_str(), "rb");
+		if (!file)	return false;
+		string idx;
+		{
+			BgzfReader reader(file);
+			const uint32_t len = 0x10000;
+			for (int res = len; res == len; ) {
+				const size_t size = idx.size();
+				idx.resize(size + len);
+				res = reader.Read(idx.data() + size, len);
+				idx.resize(size + max(res, 0));
+				if (res < 0)	idx.clear();
+			}
+		}
+		fclose(file);
+
+		size_t pos = 4;
+		auto get = [&](auto& val) {
+			if (pos + sizeof val > idx.size())	Err("invalid index", iName).Throw();
+			memcpy(&val, idx.data() + pos, sizeof val);
+			pos += sizeof val;
+		};
+		int32_t refCnt, val, namesLen;
+
+		if (idx.compare(0, 4, "TBI\1"))	Err("invalid index", iName).Throw();
+		get(refCnt);
+		for (int i = 0; i < 6; i++)	get(val);		// format, columns, comment char, skip
+		get(namesLen);
+		if (pos + namesLen > idx.size())	Err("invalid index", iName).Throw();
+		vector<string> names;
+		for (const char* name = idx.data() + pos; names.size() < size_t(refCnt); name += names.back().size() + 1)
+			names.emplace_back(name);
+		pos += namesLen;
+
+		for (const string& name : names) {
+			uint64_t start = UINT64_MAX, beg, end;
+			int32_t binCnt, chunkCnt, winCnt;
+			uint32_t bin;
+
+			get(binCnt);
+			while (binCnt--) {
+				get(bin);
+				get(chunkCnt);
+				while (chunkCnt--) {
+					get(beg), get(end);
+					if (bin != TbiMetaBin && beg < start)	start = beg;
+				}
+			}
+			get(winCnt);
+			pos += size_t(winCnt) * sizeof beg;
+			if (start != UINT64_MAX)	_starts[name] = start;
+		}
+	}
+	else
+#endif
+	{
+		ifstream idx(iName);
+		string name;
+		uint64_t start;
+
+		while (idx >> name >> start)	_starts[name] = start;
+	}
+	return true;
+}
+
+bool BedIndex::Find(chrid cID, uint64_t& pos) const
+{
+	const auto it = _starts.find(Chrom::AbbrName(cID));
+
+	if (it == _starts.end())	return false;
+	pos = it->second;
+	return true;
+}
+
+/************************ end of BedIndex ************************/
+
+#ifdef _MULTITHREAD
+/************************ ChunkBedReader ************************/
+
+bool ChunkBedReader::IsSplittable(const BedReader& file)
+{
+	return (file.Type() == FT::BED || file.Type() == FT::ABED)
+		&& !file.IsZipped() && file.Length() >= 2 * PartSize;
+}
+
+ChunkBedReader::ChunkBedReader(const char* fName, unique_ptr<BedReader> header, thrid thrCnt, bool abortInval) :
+	_fName(fName),
+	_condFName(header->CondFileName()),
+	_type(header->Type()),
+	_scoreInd(header->_scoreInd),
+	_chrMarkPos(header->_chrMarkPos),
+	_abortInv(abortInval),
+	_thrCnt(thrCnt),
+	_estItemCnt(header->EstItemCount()),
+	_part(new Part)
+{
+	const size_t fLen = header->Length();
+	header.reset();		// release file before opening it by workers
+
+	// ** split file at line boundaries
+	FILE* file = fopen(fName, "rb");
+	if (!file)	Err(Err::F_OPEN, fName).Throw();
+	char buff[4096];
+	_bounds.push_back(0);
+	for (size_t pos = PartSize; pos < fLen; pos = _bounds.back() + PartSize) {
+		// search for the LF starting from the char before nominal boundary
+		if (_fseeki64(file, --pos, SEEK_SET))	break;
+		for (size_t readLen; (readLen = fread(buff, 1, sizeof(buff), file)) > 0; pos += readLen) {
+			const char* lf = (const char*)memchr(buff, LF, readLen);
+			if (lf) { pos += lf - buff + 1; break; }
+		}
+		if (pos >= fLen)	break;
+		_bounds.push_back(pos);
+	}
+	_bounds.push_back(fLen);
+	fclose(file);
+
+	LaunchParts();
+}
+
+unique_ptr<ChunkBedReader::Part> ChunkBedReader::ParsePart(size_t ind, size_t lineBase) const
+{
+	const size_t startPos = _bounds[ind], endPos = _bounds[ind + 1];
+	auto part = make_unique<Part>();
+	PartReader file(_fName, _type, startPos, endPos, lineBase, _abortInv);
+	const bool isABED = _type == FT::ABED;
+	const bool isScore = _scoreInd < FT::FileParams(_type).MaxFieldCnt;
+	char chrMark[2]{ 0,0 };		// first 2 chars of previous chrom's mark
+
+	// Adds null-terminated string to the strings pool and returns its offset
+	auto addString = [&part](const char* str) {
+		const auto offs = uint32_t(part->Strings.size());
+		part->Strings.append(str, strlen(str) + 1);
+		return offs;
+	};
+
+	part->Ind = ind;
+	part->Items.reserve(size_t(double(_estItemCnt) * (endPos - startPos) / _bounds.back()) + 1);
+	try {
+		while (file.GetNextLine()) {
+			const char* mark = file.GetLine() + _chrMarkPos;
+			const char* name = file.StrFieldValid(BedReader::NameFieldInd);
+			Item item;
+
+			file.InitRegion(1, item.Rgn);
+			item.Value = isScore ? file.FloatFieldValid(_scoreInd) : vUNDEF;
+			item.NameOffs = name ? addString(name) : NoOffset;
+			if (part->Items.empty() || memcmp(chrMark, mark, 2)) {
+				memcpy(chrMark, mark, 2);
+				item.MarkOffs = addString(mark);
+			}
+			else
+				item.MarkOffs = NoOffset;
+			item.LineNumb = uint32_t(file.Count());
+			item.Strand = !isABED || *file.StrField(BedReader::StrandFieldInd) == PLUS;
+			part->Items.push_back(item);
+		}
+		part->Stopped = file.IsBad();
+	}
+	catch (const Err& err) {
+		part->ErrMsg = err.what();
+	}
+	part->LineCnt = file.Count();
+	return part;
+}
+
+void ChunkBedReader::LaunchParts()
+{
+	for (; _parts.size() < _thrCnt && _nextPart + 1 < _bounds.size(); _nextPart++)
+		_parts.push_back(async(launch::async,
+			&ChunkBedReader::ParsePart, this, _nextPart, 0));
+}
+
+void ChunkBedReader::ThrowPartError() const
+{
+	// the line base was unknown while the part was parsed in advance,
+	// so the invalid part is parsed again with the known base
+	const auto part = _lineBase ? ParsePart(_part->Ind, _lineBase) : nullptr;
+
+	Err((part ? part : _part)->ErrMsg).Throw();
+}
+
+bool ChunkBedReader::GetNextChrom(chrid& cID)
+{
+	if (_item->MarkOffs == NoOffset)	return false;
+	const char* mark = _part->Strings.data() + _item->MarkOffs;
+	if (!memcmp(_chrMark, mark, 2))
+		return false;
+	// next chrom
+	memcpy(_chrMark, mark, 2);
+	return SetNextChrom(cID = Chrom::ValidateID(mark));
+}
+
+bool ChunkBedReader::GetNextItem()
+{
+	while (_itemInd == _part->Items.size()) {		// current part is exhausted
+		if (!_part->ErrMsg.empty())	ThrowPartError();
+		if (_part->Stopped || _parts.empty())	return false;
+		_lineBase += _part->LineCnt;
+		_part = _parts.front().get();
+		_parts.pop_front();
+		_itemInd = 0;
+		LaunchParts();
+	}
+	_item = &_part->Items[_itemInd++];
+	return true;
+}
+
+/************************ end of ChunkBedReader ************************/
+#endif	// _MULTITHREAD
+
 #ifdef _BAM
 /************************ BamReader ************************/
 
@@ -130,6 +545,9 @@ bool BedReader::GetNextChrom(chrid& cID)
 //	@prName: true if file name should be printed in exception's message
 BamReader::BamReader(const char* fName, ChromSizes* cSizes, bool prName) : _prFName(prName)
 {
+#ifdef _MULTITHREAD
+	_reader.SetThreadCount(UniBedReader::ThrCnt);
+#endif
 	_reader.Open(fName);
 
 	// variant of estimation with max/min ~ 18
@@ -147,12 +565,32 @@ BamReader::BamReader(const char* fName, ChromSizes* cSizes, bool prName) : _prFN
 #endif // _NO_CUSTOM_CHROM
 }
 
+#ifdef _MULTITHREAD
+BamReader::BamReader(const BamReader& primer) : _prFName(primer._prFName), _estItemCnt(primer._estItemCnt)
+{
+	const string fName = primer._reader.GetFilename();
+
+	_reader.Open(fName);
+	if (!_reader.OpenIndex(fName + ".bai"))
+		Err("invalid index", fName).Throw();
+}
+
+bool BamReader::IsIndexed() const
+{
+	return FS::IsFileExist((_reader.GetFilename() + ".bai").c_str());
+}
+#endif
+
 /************************ end of BamReader ************************/
 #endif	// _BAM
 
 /************************ UniBedReader ************************/
 
 bool UniBedReader::IsTimer = false;	// if true then manage timer by Timer::Enabled, otherwise no timer
+bool UniBedReader::BuildIndex = false;	// if true then build absent BED/bedGraph index for the chrom set by user
+#ifdef _MULTITHREAD
+thrid UniBedReader::ThrCnt = 1;		// number of threads for parsing BED/ABED or decompressing BAM
+#endif
 
 chrlen UniBedReader::ChromSize(chrid cID) const
 {
@@ -294,8 +732,17 @@ UniBedReader::UniBedReader(
 	else
 #endif
 		if (type <= FT::ABED || type == FT::BGRAPH) {
-			_file = new BedReader(fName, type, scoreNumb, false, abortInval);
-			_type = ((BedReader*)_file)->Type();	// possible change of BGRAPH with WIG_FIX or WIG_VAR
+			unique_ptr<BedReader> file(new BedReader(fName, type, scoreNumb, false, abortInval));
+			_type = file->Type();	// possible change of BGRAPH with WIG_FIX or WIG_VAR
+			// the indexed file is read serially from the user chrom
+			if (Chrom::IsSetByUser() && file->JumpToChrom(Chrom::UserCID(), BuildIndex))
+				_file = file.release();
+#ifdef _MULTITHREAD
+			else if (ThrCnt > 1 && ChunkBedReader::IsSplittable(*file))
+				_file = new ChunkBedReader(fName, move(file), ThrCnt, abortInval);
+#endif
+			else
+				_file = file.release();
 		}
 		else
 			Err(
@@ -307,16 +754,31 @@ UniBedReader::UniBedReader(
 			).Throw(abortInval);
 }
 
-UniBedReader::~UniBedReader()
+#if defined _MULTITHREAD && defined _BAM
+UniBedReader::UniBedReader(const UniBedReader& primer) :
+	_type(primer._type),
+	_MaxDuplLevel(primer._MaxDuplLevel),
+	_abortInv(primer._abortInv),
+	_oinfo(eOInfo::NONE),
+	_checkSorted(primer._checkSorted),
+	_prLFafterName(false),
+	_cSizes(primer._cSizes)
 {
-#ifdef _BAM
-	if (_type == FT::BAM)
-		delete (BamReader*)_file;
-	else
-#endif
-		delete (BedReader*)_file;
+	assert(_type == FT::BAM);
+	_file = new BamReader(*(const BamReader*)primer._file);
 }
 
+void UniBedReader::AddStats(const UniBedReader& worker)
+{
+	for (size_t i = 0; i < _issues.size(); i++)
+		_issues[i].Cnt += worker._issues[i].Cnt;
+	_issues[DUPL].Cnt += worker._cDuplCnt;		// last chrom duplicates are not counted by the worker
+	for (const auto& freq : worker._lenFreq)
+		_lenFreq[freq.first] += freq.second;
+	_cCnt += worker._cCnt;
+}
+#endif
+
 void UniBedReader::PrintFirstLF()
 {
 	if (_prLFafterName) {
@@ -525,22 +987,127 @@ void Read::Print() const
 
 #ifdef _PE_READ
 
+//========== MateTable
+
+MateTable::MateTable(size_t estCnt)
+{
+	size_t capacity = MinCapacity;
+	for (estCnt = min(estCnt / 2, MaxReserve); capacity < estCnt; capacity <<= 1);
+	Alloc(capacity);
+}
+
+void MateTable::Alloc(size_t capacity)
+{
+	_slots.assign(capacity, Mate());
+	_mask = capacity - 1;
+	for (_shift = 64; capacity > 1; capacity >>= 1)	_shift--;
+}
+
+void MateTable::Grow()
+{
+	vector<Mate> slots(move(_slots));
+
+	Alloc(slots.size() << 1);
+	for (const Mate& mate : slots)
+		if (mate.Dist)	Place(mate);
+}
+
+void MateTable::Place(Mate mate)
+{
+	mate.Dist = 1;
+	for (size_t i = Home(mate.Number);; i = (i + 1) & _mask) {
+		Mate& slot = _slots[i];
+		if (!slot.Dist) { slot = mate; return; }
+		if (slot.Dist < mate.Dist)	swap(slot, mate);	// take the slot from the richer entry
+		if (++mate.Dist == numeric_limits<BYTE>::max()) {					// too long probe sequence
+			Grow();
+			Place(mate);
+			return;
+		}
+	}
+}
+
+MateTable::Mate* MateTable::Find(size_t numb)
+{
+	for (size_t i = Home(numb), dist = 1;; i = (i + 1) & _mask, dist++) {
+		Mate& slot = _slots[i];
+		if (slot.Dist < dist)			return nullptr;	// empty or richer slot: read cannot be farther
+		if (slot.Number == numb)		return &slot;
+	}
+}
+
+void MateTable::Insert(const Read& read)
+{
+	if ((_size + 1) * 8 > _slots.size() * 7)	Grow();		// keep load factor <= 7/8
+	Mate mate;
+	mate.Set(read.Start, read.End);
+	mate.Number = read.Number;
+	mate.Strand = read.Strand;
+	Place(mate);
+	if (++_size > _maxSize)	_maxSize = _size;
+}
+
+void MateTable::Erase(Mate* mate)
+{
+	size_t i = mate - _slots.data();
+
+	// shift back the following displaced entries
+	for (size_t j = (i + 1) & _mask; _slots[j].Dist > 1; i = j, j = (j + 1) & _mask) {
+		_slots[i] = _slots[j];
+		_slots[i].Dist--;
+	}
+	_slots[i].Dist = 0;
+	_size--;
+}
+
+size_t MateTable::Evict(chrlen pos)
+{
+	const size_t size = _size;
+
+	// erasing shifts the next entries back into the current slot, so it is checked again
+	for (size_t i = 0; i < _slots.size(); )
+		if (_slots[i].Dist && _slots[i].Start < pos)	Erase(&_slots[i]);
+		else											i++;
+	return size - _size;
+}
+
+void MateTable::Clear()
+{
+	for (Mate& mate : _slots)	mate.Dist = 0;
+	_size = 0;
+}
+
 //========== FragIdent
 
+void FragIdent::Evict(chrlen pos)
+{
+	if (pos < _lastPos) {				// next chrom: no mates remain for the waiting reads
+		_orphCnt += _waits.Size();
+		_waits.Clear();
+		_evictPos = 0;
+	}
+	else if (pos >= _evictPos) {		// sweep once per maximum insert size passed
+		if (pos > _maxInsert)	_orphCnt += _waits.Evict(pos - _maxInsert);
+		_evictPos = pos + _maxInsert;
+	}
+	_lastPos = pos;
+}
+
 bool FragIdent::operator()(const Read& read, Region& frag)
 {
-	auto getFrag = [](const Read& r1, const Read& r2, Region& frag) {
+	auto getFrag = [](const auto& r1, const auto& r2, Region& frag) {
 		if (r1.Strand)	frag.Set(r1.Start, r2.End);
 		else			frag.Set(r2.Start, r1.End);
 		return true;
 	};
 	bool res = false;
-	const auto itMate = _waits.find(read.Number);	// look for the read with given Numb
+	if (_maxInsert)	Evict(read.Start);
+	MateTable::Mate* const pMate = _waits.Find(read.Number);	// look for the read with given Numb
 
-	if (itMate == _waits.end())					// is read not on the waiting list?
-		_waits.emplace(read.Number, read);		// add read to the waiting list
+	if (!pMate)									// is read not on the waiting list?
+		_waits.Insert(read);					// add read to the waiting list
 	else {										// mate case
-		const Read& mate = itMate->second;
+		const MateTable::Mate& mate = *pMate;
 		if (mate.Start == _pos[mate.Strand] && read.Start == _pos[read.Strand]) {	// duplicate of the previous one
 			if (_duplAccept)
 				res = getFrag(mate, read, frag);	// dupl fragment
@@ -550,10 +1117,7 @@ bool FragIdent::operator()(const Read& read, Region& frag)
 			res = getFrag(mate, read, frag);		// uniq or first duplicate fragment
 		_pos[mate.Strand] = mate.Start;
 		_pos[read.Strand] = read.Start;
-#ifdef MY_DEBUG
-		if (_maxSize < _waits.size())	_maxSize = _waits.size();
-#endif
-		_waits.erase(itMate);					// remove read from the waiting list
+		_waits.Erase(pMate);					// remove read from the waiting list
 		_cnt++;
 	}
 	return res;
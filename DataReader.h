@@ -2,13 +2,18 @@
 DataReader.h
 Provides read|write text file functionality
 2021 Fedor Naumenko (fedor.naumenko@gmail.com)
-Last modified: 07/29/2024
+Last modified: 10/16/2026
 ***********************************************************/
 #pragma once
 
 #include "TxtFile.h"
 #include <map>
 #include <unordered_map>
+#ifdef _MULTITHREAD
+#include <future>
+#include <deque>
+#include <atomic>
+#endif
 
 #ifdef _PE_READ
 #define _READS
@@ -37,6 +42,8 @@ protected:
 	bool SetNextChrom(chrid cID);
 
 public:
+	virtual ~DataReader() {}
+
 	// Returns estimated number of items
 	virtual size_t EstItemCount() const = 0;
 
@@ -92,8 +99,11 @@ public:
 // 'BedReader' represents unified PI for reading bed file
 class BedReader : public DataReader, public TabReader
 {
-	const BYTE	NameFieldInd = 3;	// inner index of name field
-	const BYTE	StrandFieldInd = 5;	// inner index of strand field
+#ifdef _MULTITHREAD
+	friend class ChunkBedReader;
+#endif
+	static const BYTE NameFieldInd = 3;		// inner index of name field
+	static const BYTE StrandFieldInd = 5;	// inner index of strand field
 
 	BYTE _scoreInd;				// 0-based index of 'score' filed (used for FBED and all WIGs)
 	BYTE _chrMarkPos;			// chrom's mark position in line (BED, BedGraph) or definition line (wiggle_0)
@@ -138,6 +148,13 @@ public:
 		return SetNextChrom(cID = Chrom::ValidateID(str, strlen(Chrom::Abbr)));
 	}
 
+	// Sets the reader to the first item of the chromosome via the index, if it exists.
+	//	If there is no chromosome in the index, the reading is finished.
+	//	@param cID: chrom ID
+	//	@param build: if true then build absent or outdated index
+	//	@returns: false if file is not indexed
+	bool JumpToChrom(chrid cID, bool build = false);
+
 protected:
 	// Returns estimated number of items
 	size_t EstItemCount() const { return EstLineCount(); }
@@ -188,6 +205,160 @@ protected:
 	bool ItemStrand() const { return _getStrand(); }
 };
 
+// 'BedIndex' keeps chromosomes start positions in sorted BED/bedGraph file, to read the chromosome without scanning.
+//	BGZF file is indexed by tabix-compatible index '.tbi' with virtual offsets,
+//	uncompressed file by sidecar text index '.cix' with lines <chrom> <file position>.
+//	Index older than the file is ignored.
+class BedIndex
+{
+	map<string, uint64_t> _starts;	// chromosomes start positions by chrom names
+
+public:
+	static const char* TbiExt;	// tabix index file extension
+	static const char* CixExt;	// sidecar index file extension
+
+	// Builds index of sorted BED/bedGraph file and saves it besides the file
+	//	@param fName: name of uncompressed or BGZF file
+	static void Build(const string& fName);
+
+	// Loads index of the file if it exists and is not outdated
+	//	@param fName: name of file
+	//	@param bgzf: true if file is BGZF stream
+	//	@returns: true if index is loaded
+	bool Load(const string& fName, bool bgzf);
+
+	// Returns chromosome start position
+	//	@param cID: chrom ID
+	//	@param pos: returned file position, or virtual offset for BGZF file
+	//	@returns: false if there is no chromosome
+	bool Find(chrid cID, uint64_t& pos) const;
+};
+
+#ifdef _MULTITHREAD
+// 'ChunkBedReader' represents unified PI for parallel reading of uncompressed sorted BED/ABED file.
+//	The file is split into parts at line boundaries; each part is parsed by its own worker,
+//	while items are retrieved in the original order. Items are validated by consumer (UniBedReader),
+//	so chromosome transitions, duplicates and line numbers are the same as in BedReader.
+class ChunkBedReader : public DataReader
+{
+	static const uint32_t NoOffset = UINT32_MAX;	// no string offset in the strings pool
+	static const size_t PartSize = 32 * 1024 * 1024;	// nominal size of the file part
+
+	// Parsed item
+	struct Item {
+		Region		Rgn;
+		float		Value;
+		uint32_t	NameOffs;	// name offset in the strings pool, or NoOffset if name is absent
+		uint32_t	MarkOffs;	// chrom mark offset in the strings pool, or NoOffset if mark is the same
+		uint32_t	LineNumb;	// line number within the part
+		bool		Strand;
+	};
+
+	// Parsed part of file
+	struct Part {
+		size_t	Ind = 0;			// index of the part
+		vector<Item> Items;
+		string	Strings;			// pool of null-terminated names and chrom marks
+		size_t	LineCnt = 0;		// number of lines in the part, including comments
+		string	ErrMsg;				// message of exception thrown while parsing, or empty
+		bool	Stopped = false;	// true if parsing was stopped by invalid line without exception
+	};
+
+	// 'PartReader' reads a part of file and reports about the invalid line
+	class PartReader : public TabReader
+	{
+	public:
+		using TabReader::TabReader;
+		using TxtFile::IsBad;
+	};
+
+	const string	_fName;
+	const string	_condFName;		// conditional file name
+	const FT::eType	_type;
+	const BYTE		_scoreInd;		// 0-based index of 'score' filed
+	const BYTE		_chrMarkPos;	// chrom's mark position in line
+	const bool		_abortInv;		// true if invalid instance should be completed by throwing exception
+	const thrid		_thrCnt;		// number of parsing threads
+	size_t			_estItemCnt;	// estimated number of items
+	char			_chrMark[2]{ 0,0 };		// first 2 chars of current chrom's mark
+	vector<size_t>	_bounds;		// file positions of parts boundaries
+	size_t			_nextPart = 0;	// index of the next part to launch
+	size_t			_lineBase = 0;	// number of lines before current part
+	size_t			_itemInd = 0;	// index of the next item in current part
+	const Item*		_item = nullptr;		// current item
+	unique_ptr<Part> _part;			// current part
+	deque<future<unique_ptr<Part>>> _parts;	// launched parts; declared last to be waited first
+
+	// Parses part of file
+	//	@param ind: index of the part
+	//	@param lineBase: number of lines before the part, or 0 if it is not known yet
+	//	@returns: parsed part
+	unique_ptr<Part> ParsePart(size_t ind, size_t lineBase) const;
+
+	// Launches parsing of the next parts up to the number of threads
+	void LaunchParts();
+
+	// Throws exception of current part with the line number in the whole file
+	void ThrowPartError() const;
+
+	// Returns current item line number in the whole file
+	size_t LineNumber() const { return _lineBase + _item->LineNumb; }
+
+public:
+	// Returns true if the file opened by BedReader can be read in parallel
+	static bool IsSplittable(const BedReader& file);
+
+	// Creates new instance for reading
+	//	@param fName: name of file
+	//	@param header: reader opened the file and read its header; is released by this constructor
+	//	@param thrCnt: number of parsing threads
+	//	@param abortInval: true if invalid instance should be completed by throwing exception
+	ChunkBedReader(const char* fName, unique_ptr<BedReader> header, thrid thrCnt, bool abortInval);
+
+	// Waits for the launched parts
+	~ChunkBedReader() { _parts.clear(); }
+
+	// Returns estimated number of items
+	size_t EstItemCount() const { return _estItemCnt; }
+
+	// Sets the next chromosome as the current one if they are different
+	//	@param cID: returned next chrom ID
+	//	@returns: true, if new chromosome is set as current one
+	bool GetNextChrom(chrid& cID);
+
+	// Retrieves next item's record
+	bool GetNextItem();
+
+	// Initializes item region
+	//	@param rgn: region that is initialized
+	void InitRegion(Region& rgn) const { rgn.Set(_item->Rgn.Start, _item->Rgn.End); }
+
+	// Returns true if alignment part of paired-end read
+	bool IsPairedItem()	const { return strchr(ItemName() + 1, '/'); }
+
+	// Returns current item's value (score)
+	float ItemValue()	const { return _item->Value; }
+
+	// Returns current item's name
+	const char* ItemName() const {
+		return _item->NameOffs == NoOffset ? nullptr : _part->Strings.data() + _item->NameOffs;
+	}
+
+	// Gets string containing file name and current line number.
+	const string LineNumbToStr(Err::eCode = Err::EMPTY) const { return _condFName + ": line " + to_string(LineNumber()); }
+
+	// Throws exception with message included current reading line number
+	//	@param msg: exception message
+	void ThrowExceptWithLineNumb(const string& msg) const { Err(msg, LineNumbToStr().c_str()).Throw(); }
+
+	// Gets conditional file name: name if it's printable, otherwise empty string.
+	const string CondFileName() const { return _condFName; }
+
+	// Returns current item strand: true - positive, false - negative
+	bool ItemStrand() const { return _item->Strand; }
+};
+#endif	// _MULTITHREAD
+
 class ChromSizes;	// ChromData.h
 
 #ifdef _BAM
@@ -199,9 +370,8 @@ class BamReader : public DataReader
 	// BamTools: http://pezmaster31.github.io/bamtools/struct_bam_tools_1_1_bam_alignment.html
 
 	BamTools::BamReader		_reader;
-	BamTools::BamAlignment	_read;
+	BamTools::BamAlignmentCore	_read;	// reused record without character data
 	bool			_prFName;
-	mutable string	_rName;
 	size_t _estItemCnt = vUNDEF;	// estimated number of items
 
 	// Returns SAM header data
@@ -214,13 +384,27 @@ public:
 	//	@param prName: true if file name should be printed in exception's message
 	BamReader(const char* fName, ChromSizes* cSizes, bool prName);
 
-protected:
-	// Returns estimated number of items
-	size_t EstItemCount() const { return _estItemCnt; }
+#ifdef _MULTITHREAD
+	// Clone constructor for multithreading: opens the same file with its index
+	//	@param primer: primer reader
+	BamReader(const BamReader& primer);
+
+	// Returns true if index file exists
+	bool IsIndexed() const;
+
+	// Sets the reader to the first item of the chromosome via the index
+	//	@param cID: chrom ID
+	//	@returns: false if chromosome has no items
+	bool JumpToChrom(chrid cID) { _cID = Chrom::UnID; return _reader.Jump(cID); }
+#endif
 
 	// returns chroms count
 	chrid ChromCount() const { return _reader.GetReferenceCount(); }
 
+protected:
+	// Returns estimated number of items
+	size_t EstItemCount() const { return _estItemCnt; }
+
 	// Sets the next chromosome as the current one if they are different
 	//	@param cID: returned next chrom ID
 	//	@returns: true, if new chromosome is set as current one
@@ -255,7 +439,7 @@ protected:
 	float ItemValue()	const { return _read.MapQuality; }
 
 	// Returns current item name
-	const char* ItemName() const { return (_rName = _read.Name).c_str(); }
+	const char* ItemName() const { return _read.Name; }
 
 	// Gets string containing file name and current line number.
 	const string LineNumbToStr(Err::eCode) const { return strEmpty; }
@@ -314,7 +498,7 @@ private:
 	bool	_readItem = true;	// if true then read next item, otherwise pre-read first item or nothing if _preItem is TRUE
 	bool	_preItem = false;	// if true then pre-read first item and set to FALSE after that
 	bool	_prLFafterName;
-	DataReader* _file = nullptr;// data file; unique_ptr is useless because of different type in constructor/destructor
+	DataReader* _file = nullptr;// data file
 	const ChromSizes* _cSizes;
 
 	// Resets the current accounting of items
@@ -336,6 +520,49 @@ private:
 	//	@param cnt: total count of items
 	void PrintStats(size_t cnt);
 
+#if defined _MULTITHREAD && defined _BAM
+	// Adds items statistics of the worker reader
+	void AddStats(const UniBedReader& worker);
+
+	// Passes through the chromosomes taken in turn from the common counter; called by PassByChroms() in a worker thread.
+	//	Each chromosome is reached via the index, so the functor is called the same way as in Pass().
+	//	@param func: worker functor
+	//	@param nextCID: common counter of untreated chromosomes
+	//	@param cCnt: number of chromosomes
+	//	@returns: total count of items
+	template<typename Functor>
+	size_t PassChroms(Functor& func, atomic<int>& nextCID, int cCnt)
+	{
+		size_t	cItemCnt = 0;					// count of chrom entries
+		size_t	tItemCnt = 0;					// total count of entries
+		chrid cID = Chrom::UnID, nextcID = cID;	// current, next chrom
+		chrlen	cLen = 0;						// current chrom length
+		BamReader* file = (BamReader*)_file;
+
+		for (int jumpCID; (jumpCID = nextCID++) < cCnt; ) {
+			if (!file->JumpToChrom(chrid(jumpCID)))	continue;	// no items
+			while (GetNextItem()) {
+				if (_file->GetNextChrom(nextcID)) {
+					if (nextcID != jumpCID)		break;		// chrom is passed
+					func(cID, cLen, cItemCnt, nextcID);		// close current chrom, open next one
+					ResetChrom();
+					cID = nextcID;
+					cItemCnt = 0;
+					if (_cSizes)	cLen = ChromSize(cID);
+				}
+				_file->InitRegion(_rgn);
+				if (CheckItem(cLen)) {
+					cItemCnt += func(); 					// treat entry
+					_rgn0 = _rgn;
+				}
+				tItemCnt++;
+			}
+		}
+		func(cID, cLen, cItemCnt, tItemCnt);				// close last chrom
+		return tItemCnt;
+	}
+#endif
+
 	// Returns chrom size
 	//	Defined in cpp because of call in template function (otherwise ''ChromSize' is no defined')
 	chrlen ChromSize(chrid cID) const;
@@ -362,6 +589,10 @@ protected:
 
 public:
 	static bool IsTimer;	// if true then manage timer by Timer::Enabled, otherwise no timer
+	static bool BuildIndex;	// if true then build BED/bedGraph index when the chrom is set by user and the index is absent
+#ifdef _MULTITHREAD
+	static thrid ThrCnt;	// number of threads for parsing large uncompressed BED/ABED or decompressing BAM; 1 for serial reading
+#endif
 
 	// Prints count of items
 	//	@param cnt: total count of items
@@ -397,8 +628,13 @@ public:
 		bool preReading = false
 	);
 
-	// explicit destructor
-	~UniBedReader();
+#if defined _MULTITHREAD && defined _BAM
+	// Clone constructor for multithreading: opens the same BAM file for the worker, without printing
+	//	@param primer: primer reader
+	UniBedReader(const UniBedReader& primer);
+#endif
+
+	~UniBedReader() { delete _file; }
 
 	// pass through records
 	template<typename Functor>
@@ -444,6 +680,51 @@ public:
 		//if (_oinfo >= eOInfo::NM)	dout << "_LF" << LF;
 	}
 
+#if defined _MULTITHREAD && defined _BAM
+	// Passes through records in parallel by chromosomes, if file is indexed BAM.
+	//	Each worker passes by its own clone of the reader and its own functor: it jumps via the index to the next untreated chromosome,
+	//	so each functor gets its chromosomes in ascending order with the same calls as in Pass().
+	//	To save data in chromosome order, chromosome data should be written by OrderedData::WriteChrom() with Mutex on.
+	//	Otherwise, or if chromosome is set by user, passes serially by Pass().
+	//	@param reader: primer reader; it collects the workers' statistics
+	//	@param createFunc: returns unique_ptr to functor bound to the given reader of type Reader
+	//	@param thrCnt: number of workers
+	template<typename Reader, typename Creator>
+	static void PassByChroms(Reader& reader, Creator createFunc, thrid thrCnt = ThrCnt)
+	{
+		UniBedReader& primer = reader;
+
+		if (thrCnt <= 1 || primer._type != FT::BAM || Chrom::IsSetByUser() || !((BamReader*)primer._file)->IsIndexed()) {
+			auto func = createFunc(reader);
+			reader.Pass(*func);
+			return;
+		}
+		Timer timer(IsTimer);
+		vector<unique_ptr<Reader>> readers;
+		vector<decltype(createFunc(reader))> funcs;
+		for (thrid i = 0; i < thrCnt; i++) {
+			readers.emplace_back(new Reader(reader));
+			funcs.push_back(createFunc(*readers.back()));
+		}
+
+		const int cCnt = ((BamReader*)primer._file)->ChromCount();
+		atomic<int> nextCID{ 0 };
+		vector<future<size_t>> passes;
+		for (thrid i = 0; i < thrCnt; i++)
+			passes.push_back(async(launch::async, [&, i] {
+				try { return readers[i]->PassChroms(*funcs[i], nextCID, cCnt); }
+				catch (...) { nextCID = cCnt; throw; }	// stop other workers
+			}));
+
+		size_t	tItemCnt = 0;
+		for (auto& pass : passes)	tItemCnt += pass.get();
+		for (const auto& r : readers)	primer.AddStats(*r);
+
+		if (primer._oinfo >= eOInfo::STD)	primer.PrintStats(tItemCnt);
+		timer.Stop(1, true);
+	}
+#endif
+
 	// Prints LF once, if the instance constractor printed file name (i.e. called with parameter eOInfo >= eOInfo::NM).
 	//	Typically called during intermediate printing in the Pass() method, 
 	//	before the entire file is read and statistics are printed.
@@ -729,20 +1010,98 @@ public:
 
 #ifdef _PE_READ
 
+// 'MateTable' keeps PE reads waiting for their mates, keyed by read number.
+//	It is an open addressing hash table with Robin Hood linear probing, so it needs no allocation per read.
+//	Erasing shifts the following entries back instead of leaving tombstones.
+class MateTable
+{
+public:
+	// Waiting read
+	struct Mate : Region
+	{
+		size_t	Number;		// read's number
+		bool	Strand;		// true if strand is positive
+		BYTE	Dist = 0;	// distance from the home slot plus 1; 0 means empty slot
+	};
+
+private:
+	static const size_t MinCapacity = 1 << 4;
+	static const size_t MaxReserve = 1 << 20;	// maximum number of slots allocated in advance
+
+	vector<Mate> _slots;
+	size_t	_mask = 0;			// capacity - 1
+	BYTE	_shift = 0;			// right shift of the hashed number to get the home slot
+	size_t	_size = 0;			// number of waiting reads
+	size_t	_maxSize = 0;		// peak number of waiting reads
+
+	// Returns home slot of read number (Fibonacci hashing)
+	size_t Home(size_t numb) const { return size_t((uint64_t(numb) * 0x9E3779B97F4A7C15ULL) >> _shift); }
+
+	// Allocates empty slots
+	//	@param capacity: number of slots, power of 2
+	void Alloc(size_t capacity);
+
+	// Doubles capacity and rehashes waiting reads
+	void Grow();
+
+	// Places read into the table, displacing the richer entries
+	void Place(Mate mate);
+
+public:
+	// Constructor
+	//	@param estCnt: estimated number of reads; the table is pre-sized for half of them within the reasonable limit
+	MateTable(size_t estCnt = 0);
+
+	// Returns number of waiting reads
+	size_t Size() const { return _size; }
+
+	// Returns peak number of waiting reads
+	size_t MaxSize() const { return _maxSize; }
+
+	// Returns waiting read with given number, or NULL if not found
+	Mate* Find(size_t numb);
+
+	// Adds read; it should be absent
+	void Insert(const Read& read);
+
+	// Removes waiting read
+	//	@param mate: read returned by Find()
+	void Erase(Mate* mate);
+
+	// Removes waiting reads starting before given position
+	//	@param pos: minimum start position of the remaining reads
+	//	@returns: number of removed reads
+	size_t Evict(chrlen pos);
+
+	// Removes all waiting reads, keeping capacity
+	void Clear();
+};
+
 // Fragment Identifier 
 // Accepts PE reads and returns a fragment when it's recognized
 class FragIdent
 {
-	unordered_map<ULONG, Read> _waits;	// 'waiting list' - pair mate candidate's collection
+	MateTable _waits;					// 'waiting list' - pair mate candidate's collection
 	chrlen	_pos[2] = { 0,0 };			// mates start positions ([0] - neg read, [1] - pos read)
 	const bool	_duplAccept;			// if TRUE then duplicate frags are allowed
+	const fraglen _maxInsert;			// maximum fragment length; if 0 then waiting reads are never evicted
+	chrlen	_lastPos = 0;				// start position of the last accepted read
+	chrlen	_evictPos = 0;				// position from which the next eviction is performed
 	size_t _cnt = 0, _duplCnt = 0;		// total, duplicate count
-#ifdef MY_DEBUG
-	size_t	_maxSize = 0;				// maximum waiting _waits size
-#endif
+	size_t _orphCnt = 0;				// number of evicted reads
+
+	// Evicts the waiting reads whose mates cannot come anymore in coordinate-sorted input
+	//	@param pos: start position of the accepted read
+	void Evict(chrlen pos);
 
 public:
-	FragIdent(bool allowDupl) : _duplAccept(allowDupl) {}
+	// Constructor
+	//	@param allowDupl: if TRUE then duplicate frags are allowed
+	//	@param estReadCnt: estimated number of reads (EstItemCount() of the reader) to pre-size the waiting list
+	//	@param maxInsert: maximum fragment length for coordinate-sorted input:
+	//	waiting reads starting farther behind the current read are evicted as orphans; 0 turns eviction off
+	FragIdent(bool allowDupl, size_t estReadCnt = 0, fraglen maxInsert = 0)
+		: _waits(estReadCnt), _duplAccept(allowDupl), _maxInsert(maxInsert) {}
 
 	// Returns number of total fragments
 	size_t Count() const { return _cnt; }
@@ -750,15 +1109,17 @@ public:
 	// Returns number of duplicate fragments
 	size_t DuplCount() const { return _duplCnt; }
 
+	// Returns number of reads evicted without a mate
+	size_t OrphanCount() const { return _orphCnt; }
+
 	// Identifies fragment
 	//	@param read[in]: accepted PE read
 	//	@param frag[out]: identified fragment
 	//	@returns: if true then fragment is identified
 	bool operator()(const Read& read, Region& frag);
 
-#ifdef MY_DEBUG
-	size_t MaxMapSize() const { return _maxSize; }
-#endif
+	// Returns peak number of reads waiting for their mates
+	size_t MaxMapSize() const { return _waits.MaxSize(); }
 };
 
 #endif	// _PE_READ
\ No newline at end of file
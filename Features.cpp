@@ -29,6 +29,7 @@ void Features::Init(
 		file.Pass(*this);
 		_file = nullptr;
 	}
+	IndexItems();
 #ifdef _BIOCC
 	_narrowLenDistr = file.NarrowLenDistr();
 #endif
@@ -42,6 +43,80 @@ void Features::AddChrom(chrid cID, size_t cnt)
 	AddVal(cID, ItemIndices(lastInd - cnt, lastInd));
 }
 
+// The implicit interval tree is laid out as in cgranges (https://github.com/lh3/cgranges):
+// item with index i is a node of level k, where k is the number of trailing 1-bits of i;
+// leaves are even items, the root has index 2^K-1, where K is the maximal level.
+
+void Features::IndexItems()
+{
+	_maxEnds.resize(_items.size());
+	for (const auto& c : Container()) {
+		const auto& data = c.second.Data;
+		const int64_t n = int64_t(data.ItemsCount());
+		const Featr* items = _items.data() + data.FirstInd;
+		chrlen* maxEnds = _maxEnds.data() + data.FirstInd;
+		int64_t lastInd = 0;	// index of the last node on the current level
+		chrlen lastEnd = 0;		// maximal end of the subtree of the last node
+
+		for (int64_t i = 0; i < n; i += 2)	lastInd = i, lastEnd = maxEnds[i] = items[i].End;
+		for (BYTE k = 1; 1LL << k <= n; k++) {
+			const int64_t x = 1LL << (k - 1), step = x << 2;
+
+			for (int64_t i = (x << 1) - 1; i < n; i += step)
+				maxEnds[i] = max(items[i].End, max(maxEnds[i - x], i + x < n ? maxEnds[i + x] : lastEnd));
+			lastInd = lastInd >> k & 1 ? lastInd - x : lastInd + x;
+			if (lastInd < n && maxEnds[lastInd] > lastEnd)	lastEnd = maxEnds[lastInd];
+		}
+	}
+}
+
+size_t Features::Overlaps(cIter cit, const Region& rgn, vector<chrlen>* fInds) const
+{
+	struct Node {
+		int64_t	Ind;
+		BYTE	Level;
+		bool	LeftDone;	// true if the left child is already processed
+	} stack[64];
+	const auto& data = Data(cit);
+	const int64_t n = int64_t(data.ItemsCount());
+	const Featr* items = _items.data() + data.FirstInd;
+	const chrlen* maxEnds = _maxEnds.data() + data.FirstInd;
+	size_t cnt = 0;
+	BYTE t = 0, rootLevel = 0;
+
+	auto add = [&](int64_t i) { cnt++; if (fInds) fInds->push_back(chrlen(i)); };
+
+	while (1LL << (rootLevel + 1) <= n)	rootLevel++;
+	stack[t++] = { (1LL << rootLevel) - 1, rootLevel, false };
+	while (t) {
+		const Node z = stack[--t];
+		if (z.Level <= 3) {			// small subtree: scan it linearly
+			const int64_t i0 = z.Ind >> z.Level << z.Level;
+			const int64_t i1 = min<int64_t>(i0 + (1LL << (z.Level + 1)) - 1, n);
+			for (int64_t i = i0; i < i1 && items[i].Start < rgn.End; i++)
+				if (rgn.Start < items[i].End)	add(i);
+		}
+		else if (!z.LeftDone) {
+			const int64_t left = z.Ind - (1LL << (z.Level - 1));	// may be out of range
+			stack[t++] = { z.Ind, z.Level, true };
+			if (left >= n || maxEnds[left] > rgn.Start)
+				stack[t++] = { left, BYTE(z.Level - 1), false };
+		}
+		else if (z.Ind < n && items[z.Ind].Start < rgn.End) {
+			if (rgn.Start < items[z.Ind].End)	add(z.Ind);
+			stack[t++] = { z.Ind + (1LL << (z.Level - 1)), BYTE(z.Level - 1), false };
+		}
+	}
+	return cnt;
+}
+
+void Features::CountOverlaps(cIter cit, const vector<Region>& rgns, vector<chrlen>& counts) const
+{
+	counts.resize(rgns.size());
+	for (size_t i = 0; i < rgns.size(); i++)
+		counts[i] = chrlen(Overlaps(cit, rgns[i], nullptr));
+}
+
 bool Features::operator()()
 {
 	if (_file->IsJoined()) {
@@ -141,6 +216,7 @@ bool Features::Expand(chrlen expLen, const ChromSizes* cSizes, UniBedReader::eAc
 				else if (action == UniBedReader::eAction::ABORT) {
 					//Err("overlapping feature with an additional extension of " + to_string(expLen)).Throw(false, true);
 					dout << "overlapping feature with an additional expansion of " << expLen << LF;
+					IndexItems();		// items are already expanded up to the current one
 					return false;
 				}
 				else if (prev(it)->Start != UNDEFINED)		// OMIT: unmarked item
@@ -164,6 +240,7 @@ bool Features::Expand(chrlen expLen, const ChromSizes* cSizes, UniBedReader::eAc
 		}
 		_items.swap(newItems);
 	}
+	IndexItems();
 	return true;
 }
 
@@ -187,6 +187,7 @@ struct Featr : public Region
 class Features : public Items<Featr>
 {
 	FBedReader* _file = nullptr;	// valid only in constructor
+	vector<chrlen> _maxEnds;		// implicit interval tree: maximal feature end in the subtree of each item
 #ifdef _FEATR_SCORE
 	float	_maxScore = 0;			// maximal feature score after reading
 	bool	_uniScore = false;		// true if score is undefined in input data and set as 1
@@ -227,6 +228,17 @@ class Features : public Items<Featr>
 	//	@param cnt: count of chrom items
 	void AddChrom(chrid cID, size_t cnt);
 
+	// Builds the implicit augmented interval tree laid out over the sorted items of each chromosome.
+	//	Should be invoked after any change of the items positions.
+	void IndexItems();
+
+	// Searches for chromosome's features overlapping the region
+	//	@param cit: chromosome's iterator
+	//	@param rgn: query region
+	//	@param fInds: indices of overlapping features appended in ascending order, or NULL to count only
+	//	@returns: number of overlapping features
+	size_t Overlaps(cIter cit, const Region& rgn, vector<chrlen>* fInds) const;
+
 	// Scales defined score through all features to the part of 1.
 	//void ScaleScores();
 
@@ -290,6 +302,31 @@ public:
 	//	@param fInd: feature's index, or first feature by default
 	const Region& Regn(cIter cit, chrlen fInd = 0) const { return (const Region&)Item(cit, fInd); }
 
+	// Collects chromosome's features overlapping the region; thread-safe
+	//	@param cit: chromosome's iterator
+	//	@param rgn: query region
+	//	@param fInds: indices of overlapping features appended in ascending order
+	//	@returns: number of overlapping features
+	size_t FindOverlaps(cIter cit, const Region& rgn, vector<chrlen>& fInds) const { return Overlaps(cit, rgn, &fInds); }
+
+	// Collects chromosome's features covering the position; thread-safe
+	//	@param cit: chromosome's iterator
+	//	@param pos: query position
+	//	@param fInds: indices of covering features appended in ascending order
+	//	@returns: number of covering features
+	size_t FindOverlaps(cIter cit, chrlen pos, vector<chrlen>& fInds) const { return Overlaps(cit, Region(pos, pos + 1), &fInds); }
+
+	// Returns true if the position is covered by any chromosome's feature; thread-safe
+	//	@param cit: chromosome's iterator
+	//	@param pos: query position
+	bool IsCovered(cIter cit, chrlen pos) const { return Overlaps(cit, Region(pos, pos + 1), nullptr); }
+
+	// Counts chromosome's features overlapping each of the regions; thread-safe
+	//	@param cit: chromosome's iterator
+	//	@param rgns: query regions
+	//	@param counts: returned numbers of overlapping features, in the regions order
+	void CountOverlaps(cIter cit, const vector<Region>& rgns, vector<chrlen>& counts) const;
+
 	// Gets the total length of all chromosome's features
 	//	@param cit: chromosome's iterator
 	chrlen FeaturesLength(cIter cit) const;
@@ -1,10 +1,14 @@
 /**********************************************************
 OrderedData.cpp
-Last modified: 06/05/2024
+Last modified: 10/16/2026
 ***********************************************************/
 
 #include "OrderedData.h"
 #include <fstream>
+#if defined __x86_64__ || defined _M_X64
+#define _SIMD_X86
+#include <emmintrin.h>
+#endif
 
 /************************ AccumCover ************************/
 
@@ -85,6 +89,90 @@ void AccumCover::BgPrint(chrlen maxPos) const
 
 /************************ AccumCover: end ************************/
 
+/************************ DiffCover ************************/
+
+chrlen DiffCover::FindDiff(const int16_t* block, chrlen ind)
+{
+#ifdef _SIMD_X86
+	// blocks are mostly zero runs: test 4 vectors at once; SSE2 is enough since the scan is memory-bound
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i* p = (const __m128i*)(block + ind);
+
+	for (; ind + 32 <= BlockLen; ind += 32, p += 4) {
+		const __m128i v = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+			_mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3))
+		);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) != 0xFFFF)	break;
+	}
+#endif
+	for (; ind < BlockLen && !block[ind]; ind++);
+	return ind;
+}
+
+void DiffCover::Fill(covmap& cover) const
+{
+	DoWithChanges([&](chrlen pos, coval val) { cover.emplace_hint(cover.end(), pos, val); });
+}
+
+/************************ DiffCover: end ************************/
+
+#ifdef _MULTITHREAD
+/************************ WriteQueue ************************/
+
+size_t WriteQueue::MaxPendSize = size_t(1) << 28;	// maximum total size of pending data in bytes: 256 Mb
+
+WriteQueue::~WriteQueue()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_cvTask.notify_all();
+	_thread.join();
+	if (_error && !_thrown)
+		try { rethrow_exception(_error); }
+		catch (const Err& e) { Err(e.what()).Throw(false); }
+		catch (const exception& e) { Err(e.what()).Throw(false); }
+}
+
+void WriteQueue::Run()
+{
+	unique_lock<mutex> lock(_mutex);
+	for (;;) {
+		_cvTask.wait(lock, [this] { return _stop || !_tasks.empty(); });
+		if (_tasks.empty())	break;				// stopped
+		Task& task = _tasks.front();			// deque keeps the reference when the tasks are pushed
+		if (!_error) {
+			lock.unlock();
+			exception_ptr error;
+			try { task.Write(); }
+			catch (...) { error = current_exception(); }
+			lock.lock();
+			_error = error;
+		}
+		_pendSize -= task.Size;
+		_tasks.pop_front();
+		_cvDone.notify_all();
+	}
+}
+
+void WriteQueue::Push(function<void()> write, size_t size)
+{
+	unique_lock<mutex> lock(_mutex);
+	_cvDone.wait(lock, [&] { return _error || !_pendSize || _pendSize + size <= MaxPendSize; });
+	if (_error) {
+		_thrown = true;
+		rethrow_exception(_error);
+	}
+	_tasks.push_back({ move(write), size });
+	_pendSize += size;
+	_cvTask.notify_one();
+}
+
+/************************ WriteQueue: end ************************/
+#endif
+
 /************************ RegionWriter ************************/
 
 const char* RegionWriter::sGRAY = "Silver";	// "175,175,175";
@@ -138,6 +226,13 @@ reclen RegionWriter::AddChromToLine(chrid cID)
 	return LineAddStr(Chrom::AbbrName(cID));
 }
 
+void RegionWriter::WriteChromData(chrid cID, const DiffCover& cover)
+{
+	covmap map;
+	cover.Fill(map);
+	WriteChromData(cID, map);
+}
+
 
 /************************ RegionWriter: end ************************/
 
@@ -162,6 +257,19 @@ void WigWriter::WriteChromVarStepData(chrid cID, const covmap& cover)
 	}
 }
 
+void WigWriter::WriteChromVarStepData(chrid cID, const DiffCover& cover)
+{
+	// write declaration line
+	LineSetOffset();
+	StrToIOBuff(FT::WigVarSTEP + ChromMarker(cID) + " span=1");
+
+	// write data lines
+	cover.DoWithChanges([this](chrlen pos, coval val) {
+		LineAddInts(pos, val, false);	// pos, frequency
+		LineToIOBuff();
+	});
+}
+
 void WigWriter::WriteFixStepRange(chrid cID, chrlen pos, const vector<float>& vals, bool closure)
 {
 	WriteFixStepDeclLine(cID, pos - bool(vals.front()));
@@ -207,4 +315,389 @@ void BedGrWriter::WriteChromData(chrid cID, const covmap& cover)
 			LineToIOBuff(offset);
 }
 
+void BedGrWriter::WriteChromData(chrid cID, const DiffCover& cover)
+{
+	if (cover.empty())	return;
+
+	const reclen offset = AddChromToLine(cID);
+	chrlen pos0 = 0;	// previous change position
+	coval val0 = 0;		// coverage from previous change position
+
+	cover.DoWithChanges([&](chrlen pos, coval val) {
+		if (val0)
+			LineAddUInts(pos0, pos, val0, false),		// start, end, coverage
+			LineToIOBuff(offset);
+		pos0 = pos;
+		val0 = val;
+	});
+}
+
 /************************ BedGrWriter: end ************************/
+
+#ifdef _ZLIB
+/************************ BigWigWriter ************************/
+
+thrid BigWigWriter::ThrCnt = 1;		// number of threads for compressing blocks
+
+const uint32_t BwMAGIC = 0x888FFC26;	// bigWig signature
+const uint32_t CtMAGIC = 0x78CA8C91;	// chrom B+ tree signature
+const uint32_t IdxMAGIC = 0x2468ACE0;	// R-tree index signature
+const BYTE	HeaderLEN = 64;				// length of common header
+const BYTE	ZoomHeaderLEN = 24;			// length of zoom level header
+const BYTE	SummaryLEN = 40;			// length of total summary
+const BYTE	SectHeaderLEN = 24;			// length of data section header
+const BYTE	ZoomRecLEN = 32;			// length of zoom level record
+
+// Appends value to buffer in native byte order
+template<typename T>
+inline void Put(string& buff, T val) { buff.append((const char*)&val, sizeof(T)); }
+
+void BigWigWriter::Summary::Add(float val, chrlen len)
+{
+	if (!Cnt)			Min = Max = val;
+	else if (val < Min)	Min = val;
+	else if (val > Max)	Max = val;
+	Cnt += len;
+	Sum += double(val) * len;
+	SumSq += double(val) * val * len;
+}
+
+BigWigWriter::BigWigWriter(eStrand /*strand*/, const TrackFields& fields)
+	: _fName(fields.Name + ".bw"), _cSizes(fields.CSizes)
+{
+#ifdef _MULTITHREAD
+	if (ThrCnt > 1)	_pool.reset(new WorkerPool(ThrCnt));
+#endif
+	if (!(_file = fopen(_fName.c_str(), "wb")))
+		Err(Err::F_OPEN, _fName.c_str()).Throw();
+	// reserve header, zoom headers, total summary and sections count; they are filled in when closing
+	const string head(HeaderLEN + ZoomCnt * ZoomHeaderLEN + SummaryLEN + sizeof(uint64_t), 0);
+	_offset = 0;
+	Write(head);
+}
+
+BigWigWriter::~BigWigWriter()
+{
+	try { Close(); }
+	catch (const Err& e) { Err(e.what()).Throw(false); }
+	fclose(_file);
+}
+
+void BigWigWriter::Write(const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, _file) != size)
+		Err(Err::F_WRITE, _fName.c_str()).Throw();
+	_offset += size;
+}
+
+void BigWigWriter::Compress(vector<string>& buffs) const
+{
+	auto compress = [&](string& buff) {
+		uLongf len = compressBound(uLong(buff.size()));
+		string res(len, 0);
+		if (compress2((Bytef*)res.data(), &len, (const Bytef*)buff.data(), uLong(buff.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+			Err("data compression error", _fName).Throw();
+		res.resize(len);
+		buff.swap(res);
+	};
+
+#ifdef _MULTITHREAD
+	if (_pool)	// rethrows compression error
+		_pool->Run(buffs.size(), [&](size_t i) { compress(buffs[i]); });
+	else
+#endif
+		for (auto& buff : buffs)	compress(buff);
+}
+
+void BigWigWriter::WriteItems(chrid cID, const vector<Item>& items)
+{
+	if (items.empty())	return;
+
+	const uint32_t bwID = uint32_t(_chroms.size());		// bigWig chrom ID
+	chrlen cLen = items.back().End;
+	if (_cSizes && (*_cSizes)[cID] > cLen)	cLen = (*_cSizes)[cID];
+	_chroms.emplace_back(cID, cLen);
+
+	// *** fill uncompressed data sections
+	vector<string> buffs;
+	for (size_t i = 0; i < items.size(); i += ItemsPerSlot) {
+		const size_t end = min(i + ItemsPerSlot, items.size());
+		string buff;
+
+		buff.reserve(SectHeaderLEN + (end - i) * sizeof(Item));
+		Put(buff, bwID);
+		Put(buff, items[i].Start);
+		Put(buff, items[end - 1].End);
+		Put(buff, uint32_t(0));				// item step
+		Put(buff, uint32_t(0));				// item span
+		Put(buff, BYTE(1));					// type: bedGraph
+		Put(buff, BYTE(0));					// reserved
+		Put(buff, uint16_t(end - i));		// item count
+		for (size_t k = i; k < end; k++) {
+			Put(buff, items[k].Start);
+			Put(buff, items[k].End);
+			Put(buff, items[k].Val);
+			_total.Add(items[k].Val, items[k].End - items[k].Start);
+		}
+		_blocks.push_back({ bwID, items[i].Start, items[end - 1].End, 0, 0 });
+		buffs.push_back(move(buff));
+	}
+	const size_t dataCnt = buffs.size();
+	_itemCnt += items.size();
+
+	// *** fill uncompressed zoom level records: items are summarized by reduction-aligned bins
+	size_t zoomCnts[ZoomCnt];		// number of chrom's blocks by zoom levels
+	for (BYTE z = 0; z < ZoomCnt; z++) {
+		const uint64_t reduct = uint64_t(ZoomReduction) << (2 * z);
+		const size_t cnt = buffs.size();
+		string buff;
+		Region rgn;				// current record region
+		Summary sum;			// current record summary
+		chrlen blockStart = 0;	// current block start
+
+		// adds current record to the block, and the full block to buffers
+		auto addRecord = [&](bool last) {
+			if (buff.empty())	blockStart = rgn.Start;
+			Put(buff, bwID);
+			Put(buff, rgn.Start);
+			Put(buff, rgn.End);
+			Put(buff, uint32_t(sum.Cnt));
+			Put(buff, float(sum.Min));
+			Put(buff, float(sum.Max));
+			Put(buff, float(sum.Sum));
+			Put(buff, float(sum.SumSq));
+			_zooms[z].RecCnt++;
+			if (last || buff.size() == ItemsPerSlot * ZoomRecLEN) {
+				_zooms[z].Blocks.push_back({ bwID, blockStart, rgn.End, 0, 0 });
+				buffs.push_back(move(buff));
+				buff.clear();
+			}
+		};
+
+		for (const Item& item : items)
+			for (chrlen start = item.Start, end; start < item.End; start = end) {
+				end = chrlen(min(uint64_t(item.End), (start / reduct + 1) * reduct));
+				if (sum.Cnt && start / reduct != rgn.Start / reduct) {	// next bin
+					addRecord(false);
+					sum = Summary();
+				}
+				if (!sum.Cnt)	rgn.Start = start;
+				rgn.End = end;
+				sum.Add(item.Val, end - start);
+			}
+		addRecord(true);
+		zoomCnts[z] = buffs.size() - cnt;
+	}
+
+	// *** compress and save
+	for (const auto& buff : buffs)
+		if (buff.size() > _maxBlockSize)	_maxBlockSize = uint32_t(buff.size());
+	Compress(buffs);
+
+	auto it = buffs.begin();
+	for (auto blk = _blocks.end() - dataCnt; blk != _blocks.end(); blk++, it++) {
+		blk->Offset = _offset;
+		blk->Size = it->size();
+		Write(*it);
+	}
+	for (BYTE z = 0; z < ZoomCnt; z++) {
+		Zoom& zoom = _zooms[z];
+		for (auto blk = zoom.Blocks.end() - zoomCnts[z]; blk != zoom.Blocks.end(); blk++, it++) {
+			blk->Offset = zoom.Data.size();
+			blk->Size = it->size();
+			zoom.Data += *it;
+		}
+	}
+}
+
+void BigWigWriter::WriteIndex(const vector<Block>& blocks, uint64_t endOffset)
+{
+	// node item bounds
+	struct Bounds {
+		uint32_t StartID;
+		chrlen	Start;
+		uint32_t EndID;
+		chrlen	End;
+	};
+	const BYTE LeafItemLEN = 32, NodeItemLEN = 24;
+	const size_t nodeLens[] = { 4 + NodeSize * LeafItemLEN, 4 + NodeSize * NodeItemLEN };	// leaf and internal padded node lengths
+
+	// *** build levels from leaves to root; each upper level item bounds the node of lower level
+	vector<vector<Bounds>> levels(1);
+	for (const Block& blk : blocks)
+		levels[0].push_back({ blk.ChromID, blk.Start, blk.ChromID, blk.End });
+	while (levels.back().size() > NodeSize) {
+		const vector<Bounds>& lower = levels.back();
+		vector<Bounds> upper;
+		for (size_t i = 0; i < lower.size(); i += NodeSize) {
+			const Bounds& last = lower[min(i + NodeSize, lower.size()) - 1];
+			upper.push_back({ lower[i].StartID, lower[i].Start, last.EndID, last.End });
+		}
+		levels.push_back(move(upper));
+	}
+
+	// *** header
+	const Bounds root = levels[0].empty() ? Bounds{} : Bounds{ levels[0].front().StartID, levels[0].front().Start, levels[0].back().EndID, levels[0].back().End };
+	string buff;
+	Put(buff, IdxMAGIC);
+	Put(buff, NodeSize);
+	Put(buff, uint64_t(blocks.size()));
+	Put(buff, root.StartID);
+	Put(buff, root.Start);
+	Put(buff, root.EndID);
+	Put(buff, root.End);
+	Put(buff, endOffset);
+	Put(buff, uint32_t(ItemsPerSlot));
+	Put(buff, uint32_t(0));				// reserved
+
+	// *** nodes from root to leaves, level by level
+	uint64_t offset = _offset + buff.size();		// offset of the current level
+	for (size_t l = levels.size(); l--; ) {
+		const vector<Bounds>& level = levels[l];
+		const bool isLeaf = !l;
+		offset += ((level.size() + NodeSize - 1) / NodeSize) * nodeLens[!isLeaf];	// offset of the lower level
+		size_t i = 0;
+
+		do {
+			const size_t end = min(i + NodeSize, level.size());
+			const size_t start = buff.size();
+
+			Put(buff, BYTE(isLeaf));
+			Put(buff, BYTE(0));			// reserved
+			Put(buff, uint16_t(end - i));
+			for (; i < end; i++) {
+				Put(buff, level[i].StartID);
+				Put(buff, level[i].Start);
+				Put(buff, level[i].EndID);
+				Put(buff, level[i].End);
+				if (isLeaf) {
+					Put(buff, blocks[i].Offset);
+					Put(buff, blocks[i].Size);
+				}
+				else
+					Put(buff, offset + i * nodeLens[l > 1]);	// child node offset
+			}
+			buff.resize(start + nodeLens[!isLeaf]);		// pad empty slots by zero
+		} while (i < level.size());
+	}
+	Write(buff);
+}
+
+void BigWigWriter::WriteChromTree()
+{
+	// chrom B+ tree with the single leaf node; keys are sorted chrom names
+	vector<pair<string, uint32_t>> keys;		// chrom name, bigWig chrom ID
+	uint32_t keyLen = 1;
+	for (uint32_t i = 0; i < _chroms.size(); i++) {
+		keys.emplace_back(Chrom::AbbrName(_chroms[i].first), i);
+		keyLen = max(keyLen, uint32_t(keys.back().first.size()));
+	}
+	sort(keys.begin(), keys.end());
+
+	string buff;
+	Put(buff, CtMAGIC);
+	Put(buff, max(uint32_t(keys.size()), uint32_t(1)));	// node size
+	Put(buff, keyLen);
+	Put(buff, uint32_t(2 * sizeof(uint32_t)));			// value length
+	Put(buff, uint64_t(keys.size()));
+	Put(buff, uint64_t(0));								// reserved
+	Put(buff, BYTE(1));									// leaf
+	Put(buff, BYTE(0));									// reserved
+	Put(buff, uint16_t(keys.size()));
+	for (const auto& key : keys) {
+		buff += key.first;
+		buff.append(keyLen - key.first.size(), 0);
+		Put(buff, key.second);
+		Put(buff, uint32_t(_chroms[key.second].second));
+	}
+	Write(buff);
+}
+
+void BigWigWriter::Close()
+{
+	// *** full data index
+	const uint64_t indexOffset = _offset;
+	WriteIndex(_blocks, indexOffset);
+
+	// *** zoom levels; each level is included only if it at least halves the previous one
+	string head;
+	uint16_t zoomCnt = 0;
+	for (uint64_t prevCnt = _itemCnt; zoomCnt < ZoomCnt; zoomCnt++) {
+		Zoom& zoom = _zooms[zoomCnt];
+		if (!zoom.RecCnt || 2 * uint64_t(zoom.RecCnt) > prevCnt)	break;
+		prevCnt = zoom.RecCnt;
+
+		const uint64_t dataOffset = _offset;
+		Write(&zoom.RecCnt, sizeof(zoom.RecCnt));
+		for (auto& blk : zoom.Blocks)	blk.Offset += _offset;
+		Write(zoom.Data);
+		string().swap(zoom.Data);
+
+		Put(head, uint32_t(ZoomReduction << (2 * zoomCnt)));
+		Put(head, uint32_t(0));			// reserved
+		Put(head, dataOffset);
+		Put(head, _offset);				// index offset
+		WriteIndex(zoom.Blocks, _offset);
+	}
+
+	// *** chrom tree
+	const uint64_t treeOffset = _offset;
+	WriteChromTree();
+	Write(&BwMAGIC, sizeof(BwMAGIC));
+
+	// *** header, zoom headers, total summary and sections count
+	string buff;
+	Put(buff, BwMAGIC);
+	Put(buff, uint16_t(4));									// version
+	Put(buff, zoomCnt);
+	Put(buff, treeOffset);
+	Put(buff, uint64_t(HeaderLEN + ZoomCnt * ZoomHeaderLEN + SummaryLEN));	// full data offset
+	Put(buff, indexOffset);
+	Put(buff, uint16_t(0));									// field count
+	Put(buff, uint16_t(0));									// defined field count
+	Put(buff, uint64_t(0));									// autoSql offset
+	Put(buff, uint64_t(HeaderLEN + ZoomCnt * ZoomHeaderLEN));	// total summary offset
+	Put(buff, _maxBlockSize);
+	Put(buff, uint64_t(0));									// extension offset
+	buff += head;
+	buff.resize(HeaderLEN + ZoomCnt * ZoomHeaderLEN);
+	Put(buff, _total.Cnt);
+	Put(buff, _total.Min);
+	Put(buff, _total.Max);
+	Put(buff, _total.Sum);
+	Put(buff, _total.SumSq);
+	Put(buff, uint64_t(_blocks.size()));
+	if (fseek(_file, 0, SEEK_SET))	Err(Err::F_WRITE, _fName.c_str()).Throw();
+	Write(buff);
+}
+
+void BigWigWriter::WriteChromData(chrid cID, const covmap& cover)
+{
+	if (cover.empty())	return;
+
+	vector<Item> items;
+	items.reserve(cover.size());
+	auto it0 = cover.cbegin(), it = it0;
+	for (++it; it != cover.cend(); it0 = it++)
+		if (it0->second)
+			items.push_back({ it0->first, it->first, float(it0->second) });
+	WriteItems(cID, items);
+}
+
+void BigWigWriter::WriteChromData(chrid cID, const DiffCover& cover)
+{
+	vector<Item> items;
+	chrlen pos0 = 0;	// previous change position
+	coval val0 = 0;		// coverage from previous change position
+
+	cover.DoWithChanges([&](chrlen pos, coval val) {
+		if (val0)
+			items.push_back({ pos0, pos, float(val0) });
+		pos0 = pos;
+		val0 = val;
+	});
+	WriteItems(cID, items);
+}
+
+/************************ BigWigWriter: end ************************/
+#endif	// _ZLIB
@@ -2,12 +2,17 @@
 OrderedData.h
 Provides chromosomally sorted data functionality
 2022 Fedor Naumenko (fedor.naumenko@gmail.com)
-Last modified: 06/19/2024
+Last modified: 10/16/2026
 ***********************************************************/
 #pragma once
 
 #include "ChromData.h"
 #include <assert.h>
+#include <atomic>
+#ifdef _MULTITHREAD
+#include <deque>
+#include <future>
+#endif
 
 enum eStrand { TOTAL = 0, FWD, RVS, CNT };
 
@@ -67,6 +72,95 @@ public:
 #endif
 };
 
+// 'DiffCover' represents cumulative chrom's fragment coverage data as a difference array
+//	and implements the same filling methods as AccumCover in a constant time.
+//	The array is split into blocks allocated on demand, so only covered chrom parts occupy memory.
+//	The coverage itself is restored by prefix sum.
+//	Memory trade-off: AccumCover takes about 48 bytes per coverage change point,
+//	DiffCover takes 2 bytes per position of each touched block (128 Kb), regardless of the data density.
+//	So DiffCover is smaller only if there is more than one change point per 24 positions;
+//	a 250 Mb chrom densely covered takes 500 Mb per strand.
+class DiffCover
+{
+	static const BYTE	BlockShift = 16;				// binary logarithm of block length
+	static const chrlen	BlockLen = 1 << BlockShift;		// number of positions in block
+
+	vector<vector<int16_t>> _blocks;	// coverage differences by blocks; empty block is unallocated
+	map<chrlen, int32_t>	_spill;		// differences which do not fit into the block counters
+
+	// Adds coverage difference at position
+	//	@param pos: position
+	//	@param diff: coverage difference
+	void AddDiff(chrlen pos, int32_t diff) {
+		const size_t ind = pos >> BlockShift;
+		if (ind >= _blocks.size())	_blocks.resize(ind + 1);
+		auto& block = _blocks[ind];
+		if (block.empty())	block.resize(BlockLen);
+		int16_t& val = block[pos & (BlockLen - 1)];
+		const int32_t sum = val + diff;
+		if (sum == int16_t(sum))	val = int16_t(sum);
+		else	_spill[pos] += diff;	// rare case of many fragments starting or ending at the same position
+	}
+
+	// Returns index of the first nonzero difference in the block starting from given index,
+	//	or BlockLen if there are no more differences
+	//	@param block: block of differences
+	//	@param ind: start index
+	static chrlen FindDiff(const int16_t* block, chrlen ind);
+
+public:
+	// Adds fragment to accumulate the coverage
+	void AddRegion(const Region& frag) { AddDiff(frag.Start, 1); AddDiff(frag.End, -1); }
+#ifdef _WIG_READER
+	// Adds next sequential region with value; adjacent regions with equal values are merged
+	void AddNextRegion(const Region& rgn, coval val) { AddDiff(rgn.Start, val); AddDiff(rgn.End, -int32_t(val)); }
+#endif
+
+	// Removes all data
+	void clear() { _blocks.clear(); _spill.clear(); }
+
+	// Returns true if no data was added
+	bool empty() const { return _blocks.empty(); }
+
+	// Returns size of allocated blocks in bytes
+	size_t MemSize() const {
+		size_t cnt = 0;
+		for (const auto& block : _blocks)	cnt += !block.empty();
+		return cnt * BlockLen * sizeof(int16_t) + _spill.size() * (sizeof(pair<chrlen, int32_t>) + 4 * sizeof(void*));
+	}
+
+	// Fills the coverage map in the same form as AccumCover: position and coverage value from it,
+	//	for each position where the coverage changes
+	//	@param cover: filled coverage map
+	void Fill(covmap& cover) const;
+
+	// Calls functor for each position where the coverage changes, in ascending order.
+	//	The coverage is only restored at the nonzero differences; unallocated blocks and zero runs are skipped.
+	//	@param f: functor with parameters: position, coverage value from it
+	template<typename F>
+	void DoWithChanges(F f) const
+	{
+		int32_t val = 0;		// current coverage
+		auto itSpill = _spill.cbegin();
+
+		for (size_t i = 0; i < _blocks.size(); i++) {
+			const auto& block = _blocks[i];
+			if (block.empty())	continue;
+			const chrlen pos = chrlen(i << BlockShift);
+			for (chrlen j = FindDiff(block.data(), 0); ; j = FindDiff(block.data(), j + 1)) {
+				// spilled differences at positions with zero block counter
+				for (; itSpill != _spill.cend() && itSpill->first < pos + j; itSpill++)
+					if (itSpill->second)	f(itSpill->first, coval(val += itSpill->second));
+				if (j == BlockLen)	break;
+				int32_t diff = block[j];
+				if (itSpill != _spill.cend() && itSpill->first == pos + j)
+					diff += itSpill++->second;
+				if (diff)	f(pos + j, coval(val += diff));
+			}
+		}
+	}
+};
+
 // 'Freq' represents cumulative position frequency
 class Freq : public covmap
 {
@@ -99,6 +193,7 @@ struct TrackFields
 	bool UseScore = false;
 	const char* Color = NULL;
 	eShade	Shade = LIGHT;
+	const ChromSizes* CSizes = nullptr;	// chrom sizes; used by binary writers
 
 	// Basic constructor
 	//	@param name: track name
@@ -110,11 +205,11 @@ struct TrackFields
 
 	// Copy constructor width overridden fields
 	TrackFields(const TrackFields& params, bool itemRgb, bool useScore, const char* color = NULL)
-		: Name(params.Name), Descr(params.Descr), CommLine(params.CommLine), ItemRgb(itemRgb), UseScore(useScore), Color(color) {}
+		: Name(params.Name), Descr(params.Descr), CommLine(params.CommLine), ItemRgb(itemRgb), UseScore(useScore), Color(color), CSizes(params.CSizes) {}
 
 	// Copy constructor width extended name and overridden fields
 	TrackFields(const TrackFields& params, const string& addName, const char* descr, bool itemRgb, bool useScore, const char* color = NULL)
-		: Name(params.Name + addName), Descr(descr), CommLine(params.CommLine), ItemRgb(itemRgb), UseScore(useScore), Color(color) {}
+		: Name(params.Name + addName), Descr(descr), CommLine(params.CommLine), ItemRgb(itemRgb), UseScore(useScore), Color(color), CSizes(params.CSizes) {}
 };
 
 class RegionWriter : public TxtWriter
@@ -130,6 +225,9 @@ protected:
 
 	virtual void WriteChromData(chrid cID, const covmap& cover) {};
 
+	// Writes chrom's coverage given by differences; by default through the coverage map
+	virtual void WriteChromData(chrid cID, const DiffCover& cover);
+
 //public:
 	//const string& FileName() const { return TxtFile::FileName(); }
 };
@@ -156,6 +254,9 @@ public:
 	// Fill IO buffer by <position>-<value> lines
 	void WriteChromVarStepData(chrid cID, const covmap& cover);
 
+	// Fill IO buffer by <position>-<value> lines directly from coverage differences
+	void WriteChromVarStepData(chrid cID, const DiffCover& cover);
+
 	// Adds to IO buffer declaration line and lines, each containing one value
 	//	@param cID: chrom ID
 	//	@param pos: range start position
@@ -183,6 +284,9 @@ public:
 
 	// Fill IO buffer by chrom cover
 	void WriteChromData(chrid cID, const covmap& cover) override { WriteChromVarStepData(cID, cover); }
+
+	// Fill IO buffer by chrom cover given by differences
+	void WriteChromData(chrid cID, const DiffCover& cover) override { WriteChromVarStepData(cID, cover); }
 };
 
 // 'BedGrWriter' implements methods for writing cover in BedGraph format
@@ -197,8 +301,114 @@ public:
 
 	// Fill IO buffer by chrom cover
 	void WriteChromData(chrid cID, const covmap& cover) override;
+
+	// Fill IO buffer by chrom cover given by differences
+	void WriteChromData(chrid cID, const DiffCover& cover) override;
 };
 
+#ifdef _ZLIB
+// 'BigWigWriter' implements methods for writing cover in binary indexed bigWig format.
+//	Chrom data are written as zlib-compressed bedGraph sections as they come;
+//	zoom levels data are accumulated compressed in memory.
+//	Index, zoom levels, chrom tree and header are written when closing.
+class BigWigWriter
+{
+	static const BYTE	ZoomCnt = 10;			// maximum number of zoom levels
+	static const chrlen	ZoomReduction = 256;	// reduction of the first zoom level; each next is 4 times bigger
+	static const uint16_t ItemsPerSlot = 1024;	// maximum number of items in compressed block
+	static const uint32_t NodeSize = 256;		// maximum number of items in index node
+
+	// bedGraph item
+	struct Item {
+		chrlen	Start, End;
+		float	Val;
+	};
+
+	// compressed block location
+	struct Block {
+		uint32_t ChromID;
+		chrlen	Start, End;
+		uint64_t Offset, Size;
+	};
+
+	// zoom level data
+	struct Zoom {
+		uint32_t	RecCnt = 0;		// number of summary records
+		vector<Block> Blocks;		// compressed blocks; offsets are relative to data start
+		string		Data;			// compressed summary records
+	};
+
+	// data summary
+	struct Summary {
+		uint64_t Cnt = 0;			// number of covered bases
+		double	Min = 0, Max = 0, Sum = 0, SumSq = 0;
+
+		// Adds value with the length
+		void Add(float val, chrlen len);
+	};
+
+	string	_fName;						// file name
+	FILE*	_file;						// file stream
+	uint64_t _offset;					// current file offset
+	uint32_t _maxBlockSize = 0;			// maximum uncompressed block size
+	uint64_t _itemCnt = 0;				// number of written items
+	const ChromSizes* _cSizes;			// chrom sizes or null
+	vector<pair<chrid, chrlen>> _chroms;// written chrom IDs and sizes by bigWig chrom IDs
+	vector<Block>	_blocks;			// data blocks
+	Zoom			_zooms[ZoomCnt];	// zoom levels
+	Summary			_total;				// total summary
+#ifdef _MULTITHREAD
+	unique_ptr<WorkerPool> _pool;		// compressing threads; null for serial compressing
+#endif
+
+	// Writes bytes to file
+	void Write(const void* data, size_t size);
+
+	// Writes buffer to file
+	void Write(const string& buff) { Write(buff.data(), buff.size()); }
+
+	// Compresses buffers in place, in parallel if allowed
+	//	@param buffs: uncompressed buffers
+	void Compress(vector<string>& buffs) const;
+
+	// Writes chrom's bedGraph items with their zoom levels
+	//	@param cID: chrom ID
+	//	@param items: ordered items
+	void WriteItems(chrid cID, const vector<Item>& items);
+
+	// Writes R-tree index of the blocks
+	//	@param blocks: ordered blocks
+	//	@param endOffset: offset following the indexed data
+	void WriteIndex(const vector<Block>& blocks, uint64_t endOffset);
+
+	// Writes chrom B+ tree
+	void WriteChromTree();
+
+	// Writes index, zoom levels, chrom tree and header
+	void Close();
+
+public:
+	static thrid ThrCnt;	// number of threads for compressing blocks; 1 for serial compressing
+
+	// Creates new instance for writing cover to bigWig file.
+	//	@param strand: strand; not used since bigWig has no track line
+	//	@param fields: BED/WIG track fields; only the name and chrom sizes are used
+	BigWigWriter(eStrand strand, const TrackFields& fields);
+
+	// Completes and closes file
+	~BigWigWriter();
+
+	// Returns file name
+	const string& FileName() const { return _fName; }
+
+	// Writes chrom cover
+	void WriteChromData(chrid cID, const covmap& cover);
+
+	// Writes chrom cover given by differences
+	void WriteChromData(chrid cID, const DiffCover& cover);
+};
+#endif	// _ZLIB
+
 inline int StrandShift(BYTE dim) { return dim != 2; }
 
 // 'Writers' keeps the set of writers of the same type
@@ -210,7 +420,7 @@ public:
 	vector<WRITER*> _files;
 
 public:
-	// reates writers according to dimension
+	// �reates writers according to dimension
 	//	@param dim: number of data (dimension); should be 1 (total only), 2 (strands only) or 3 (total and strands)
 	//	@param fields: BED/WIG track fields
 	Writers(BYTE dim, TrackFields& fields)
@@ -244,6 +454,12 @@ public:
 
 //===== ORDERED DATA
 
+// Returns approximate size of the container data in bytes, considering tree node overhead
+template <typename T>
+size_t MemSize(const T& data) { return data.size() * (sizeof(typename T::value_type) + 4 * sizeof(void*)); }
+
+inline size_t MemSize(const DiffCover& data) { return data.MemSize(); }
+
 // 'DataSet' keeps the set of data of the same type - total, or strands, or total and strands
 template <typename DATA>
 class DataSet
@@ -252,9 +468,6 @@ class DataSet
 	BYTE _strandShift;
 
 public:
-	bool Closed = true;		// true if data generation is completed or data is empty
-	bool Unsaved = true;	// true if data is still unsaved
-
 	// Constructor
 	//	@param dim: number of data (dimension); should be 1 (total only), 2 (strands only) or 3 (total and strands)
 	DataSet(BYTE dim = 1) : _strandShift(StrandShift(dim)) { assert(dim); _data.resize(dim); }
@@ -286,8 +499,6 @@ public:
 	const DATA& StrandDataByInd(BYTE ind) const { return _data[ind + _strandShift]; }
 
 
-	void Reinit() { Closed = false; Unsaved = true; }
-
 	void Clear() { for (DATA& d : _data) d.clear(); }
 
 	bool Empty() const {
@@ -295,32 +506,103 @@ public:
 		return true;
 	}
 
+	// Returns approximate size of data in bytes
+	size_t MemSize() const {
+		size_t size = 0;
+		for (const DATA& d : _data)	size += ::MemSize(d);
+		return size;
+	}
+
 	// Returnes true if strands are defined
 	bool Strands() const { return _data.size() > 1; }
 };
 
+#ifdef _MULTITHREAD
+// 'WriteQueue' performs writing tasks in a dedicated thread in the order they are pushed.
+//	Pushing is blocked while the total size of pending data exceeds the limit.
+class WriteQueue
+{
+	struct Task {
+		function<void()> Write;	// writing function
+		size_t	Size;			// size of written data in bytes
+	};
+
+	deque<Task>	_tasks;				// pending tasks
+	size_t	_pendSize = 0;			// total size of pending data
+	bool	_stop = false;			// true if the thread should be stopped after pending tasks
+	bool	_thrown = false;		// true if writing exception was rethrown by Push()
+	exception_ptr _error;			// writing exception; the following tasks are skipped
+	mutex	_mutex;
+	condition_variable _cvTask;		// notifies writing thread of new task
+	condition_variable _cvDone;		// notifies pushing threads of completed task
+	thread	_thread;
+
+	// Performs tasks in a loop until stopped
+	void Run();
+
+public:
+	static size_t MaxPendSize;		// maximum total size of pending data in bytes
+
+	// Creates instance and starts writing thread
+	WriteQueue() { _thread = thread(&WriteQueue::Run, this); }
+
+	// Completes pending tasks and stops writing thread
+	~WriteQueue();
+
+	// Adds writing task, waiting while pending data exceeds the limit; rethrows previous writing exception
+	//	@param write: writing function
+	//	@param size: size of written data in bytes
+	void Push(function<void()> write, size_t size);
+};
+#endif
+
 // 'OrderedData' keeps the chromosome datasets and optionally the set of writers these datasets to file.
 // Witing to the file is done in order by chromosomes.
 template <typename DATA, typename WRITER>
 class OrderedData
 {
-	template <typename DATA>
-	struct ChromDataSet : public Chroms<DataSet<DATA>>
+	// Chrom's data state in writing order
+	enum eState : BYTE {
+		IDLE,		// chrom data is not opened yet; is passed if any next chrom data is closed
+		OPEN,		// chrom data is being generated
+		CLOSED,		// chrom data is completed, but not written yet
+		PASSED		// chrom data is written or passed
+	};
+
+	template <typename DT>
+	struct ChromDataSet : public Chroms<DataSet<DT>>
 	{
+		vector<chrid>	IDs;					// chrom IDs in writing order
+		vector<size_t>	Slots;					// writing order index by chrom ID
+		unique_ptr<atomic<BYTE>[]> States;		// chrom data states in writing order
+		atomic<size_t>	Head{ 0 };				// index of the next chrom data to write
+		atomic<size_t>	ClosedEnd{ 0 };			// index following the last closed chrom data
+
 		// Initializing constructor
 		//	@param cSizes: chrom sizes instance
 		//	@param dim: number of data (dimension); should be 1 (total only), 2 (strands only) or 3 (total and strands)
 		ChromDataSet(const ChromSizes& cSizes, BYTE dim) {
 			for (const auto& cs : cSizes)
-				if (cs.second.Treated)
-					Chroms<DataSet<DATA>>::AddVal(cs.first, move(DataSet<DATA>(dim)));
+				if (cs.second.Treated) {
+					Chroms<DataSet<DT>>::AddVal(cs.first, move(DataSet<DT>(dim)));
+					if (cs.first >= Slots.size())	Slots.resize(size_t(cs.first) + 1);
+					Slots[cs.first] = IDs.size();
+					IDs.push_back(cs.first);
+				}
+			States.reset(new atomic<BYTE>[IDs.size()]);
+			for (size_t i = 0; i < IDs.size(); i++)	States[i] = IDLE;
 		}
+
+		// Returns state of chrom data
+		atomic<BYTE>& State(chrid cID) { return States[Slots[cID]]; }
 	};
 
-	mutable mutex _mutex;						// only primer mutex is used
 	BYTE _dim;									// dimension
 	unique_ptr<ChromDataSet<DATA>> _chromsData;	// common chroms data collection (datasets)
 	const OrderedData& _primer;					// primer instance to share mutex and collections
+#ifdef _MULTITHREAD
+	unique_ptr<WriteQueue> _writeQueue;			// background writer in multithreading mode; only primer queue is used
+#endif
 
 protected:
 	DataSet<DATA>* _data{};						// current accumulated chromosome data; used 
@@ -343,13 +625,55 @@ private:
 	void WriteChromData(const chrid cID, DataSet<DATA>& data, bool clearData)
 	{
 		if (data.Empty())	return;		// no chrom data in input file
-		data.Unsaved = false;
+#ifdef _MULTITHREAD
+		if (_primer._writeQueue) {		// write in background: the closed data is not changed by the other threads
+			const OrderedData& primer = _primer;
+			_primer._writeQueue->Push(
+				[&primer, cID, &data, clearData] { primer.WriteData(cID, data, clearData); },
+				data.MemSize()
+			);
+			return;
+		}
+#endif
+		WriteData(cID, data, clearData);
+	}
+
+	// Writes chrom's data by writers
+	//	@param cID: chrom ID
+	//	@param data: chrom's data
+	//	@param clearData: if true then the chrom's data will be clear
+	void WriteData(const chrid cID, DataSet<DATA>& data, bool clearData) const
+	{
 		BYTE i = 0;
 		_primer._writers->Do([&](auto f) { f->WriteChromData(cID, data.DataByInd(i++)); });
 		if (clearData)
 			data.Clear();
 	}
 
+	// Writes closed chroms data in chrom order, starting from the head one, until the first open one.
+	//	Idle chroms data preceding the last closed one are passed.
+	//	Only the thread that has changed the head state writes its data, so the writing is sequential without lock.
+	//	@param clearData: if true then the chrom's data will be clear
+	void WriteClosedChroms(bool clearData)
+	{
+		ChromDataSet<DATA>& chroms = *_primer._chromsData;
+
+		for (size_t i; (i = chroms.Head) < chroms.IDs.size(); ) {
+			BYTE state = chroms.States[i];
+			if (state == IDLE) {
+				if (i >= chroms.ClosedEnd)	return;		// no closed data after it yet
+			}
+			else if (state != CLOSED)		return;		// open, or is written by another thread
+			if (!chroms.States[i].compare_exchange_strong(state, PASSED))
+				continue;								// state is changed by another thread
+			if (state == CLOSED) {
+				const chrid cID = chroms.IDs[i];
+				WriteChromData(cID, chroms.Data(cID), clearData);
+			}
+			chroms.Head = i + 1;						// pass the head to the next chrom
+		}
+	}
+
 public:
 
 	// Primer constructor
@@ -364,7 +688,11 @@ public:
 	{
 		if (write) {
 			TrackFields fields(fname, descr, commLine, shade);
+			fields.CSizes = &cSizes;
 			_writers.reset(new Writers<WRITER>(dim, fields));
+#ifdef _MULTITHREAD
+			if (Mutex::isOn())	_writeQueue.reset(new WriteQueue);
+#endif
 		}
 	}
 
@@ -372,14 +700,24 @@ public:
 	//	@param data: primer data
 	OrderedData(const OrderedData& data) : _primer(data) {}
 
+#ifdef _MULTITHREAD
+	// Completes background writing
+	~OrderedData() { _writeQueue.reset(); }
+#endif
+
 	// Returns chromosome's data
 	DataSet<DATA>& ChromData(chrid cID) { return _chromsData->Data(cID); }
 	const DataSet<DATA>& ChromData(chrid cID) const { return _chromsData->Data(cID); }
 
 	void Clear() { _data->Clear(); }
 
-	// Sets chromosome as current (for accumulating only)
-	void SetChrom(chrid cID) { (_data = &(_primer._chromsData->Data(cID)))->Reinit(); }
+	// Sets chromosome as current
+	void SetChrom(chrid cID)
+	{
+		_data = &_primer._chromsData->Data(cID);
+		BYTE state = IDLE;
+		_primer._chromsData->State(cID).compare_exchange_strong(state, OPEN);	// if passed, it will be written out of order
+	}
 
 	// Save chromosome's data by defined writers in chromosome order; of no writes are set, does nothing
 	//	@param cID: chrom ID
@@ -387,23 +725,21 @@ public:
 	void WriteChrom(const chrid cID, bool clearData = true)
 	{
 		// Chroms data are filled in different threads independently.
-		// To save them in chrom sorted order the total pool is examined each time the next data is completed.
-		// If previous data are filled without gups in chrom order, they are recorded and optionally removed from the pool.
+		// To save them in chrom sorted order, each chrom data has an atomic state, and the head index points to the next one to write.
+		// Closing data, the thread writes all data closed without gaps from the head, so no lock is needed.
+		// In multithreading mode they are passed to the background writer.
 
 		if (!_primer._writers)	return;
-		if (Mutex::isOn())	
-			_primer._mutex.lock();
-		DataSet<DATA>& data = _primer._chromsData->Data(cID);
-		bool save = data.Closed = true;					// mark the recorded chromosome data as closed
-		for (auto it = _primer._chromsData->cBegin(); CID(it) < cID; it++)
-			if (it->second.Data.Unsaved)
-				if (bool(save = it->second.Data.Closed))	// chrom data is closed, save it
-					WriteChromData(CID(it), _primer._chromsData->Data(CID(it)), clearData);
-				else
-					break;								// some of chrom data aren't saved
-		if (save)
-			WriteChromData(cID, data, clearData);		// write the recorded chromosome data
-		if (Mutex::isOn())	_primer._mutex.unlock();
+		ChromDataSet<DATA>& chroms = *_primer._chromsData;
+		atomic<BYTE>& cState = chroms.State(cID);
+		BYTE state = cState;
+		while (state <= OPEN && !cState.compare_exchange_weak(state, CLOSED));
+		if (state == PASSED)	WriteChromData(cID, chroms.Data(cID), clearData);	// data opened after passing: write out of order
+		if (state > OPEN)	return;		// if closed, it is already waiting to be written in order
+		const size_t end = chroms.Slots[cID] + 1;
+		for (size_t closedEnd = chroms.ClosedEnd; closedEnd < end
+			&& !chroms.ClosedEnd.compare_exchange_weak(closedEnd, end); );
+		WriteClosedChroms(clearData);
 	}
 
 	// For current chromosome adds fragment to total coverage
@@ -1,11 +1,17 @@
 /**********************************************************
 TxtFile.cpp
-Last modified: 07/19/2024
+Last modified: 10/16/2026
 ***********************************************************/
 
 #include "TxtFile.h"
-#include <fstream>	// to write ChromDefRegions
+#include "TxtScan.h"
+#include <fstream>	// to write ChromDefRegions, FaIndex
+#include <algorithm>	// find_if
 #include <assert.h>
+#include <atomic>
+#ifdef __unix__
+#include <sys/mman.h>	// mmap()
+#endif
 
 const BYTE TabReaderPar::BGLnLen = Chrom::MaxAbbrNameLength + 2 * 9;	// 2*pos + correction
 const BYTE TabReaderPar::WvsLnLen = 9 + 3 + 2 + 25;	// pos + val + TAB + LF + correction
@@ -75,7 +81,232 @@ const string FT::Ext(eType t, bool isZip)
 
 /************************ end of class FT ************************/
 
+#ifdef _ZLIB
+/************************ BgzfWriter ************************/
+
+thrid BgzfWriter::ThrCnt = 1;	// number of threads for compressing blocks
+
+const BYTE BgzfHeaderLEN = 18;	// length of BGZF member header
+const BYTE BgzfFooterLEN = 8;	// length of BGZF member footer: CRC32 and uncompressed length
+
+bool BgzfWriter::CompressBlock(const char* data, uint32_t len, string& dst)
+{
+	// gzip header with 'BC' extra subfield keeping the total member length - 1
+	static const BYTE header[BgzfHeaderLEN] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0 };
+	const uint32_t maxLen = 0x10000;		// maximum length of member
+	z_stream zs{};
+
+	dst.resize(maxLen);
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+	zs.next_in = (Bytef*)data;
+	zs.avail_in = len;
+	zs.next_out = (Bytef*)dst.data() + BgzfHeaderLEN;
+	zs.avail_out = maxLen - BgzfHeaderLEN - BgzfFooterLEN;
+	const int res = deflate(&zs, Z_FINISH);		// the data of BlockLen always fits uncompressible
+	deflateEnd(&zs);
+	if (res != Z_STREAM_END)	return false;
+
+	const uint32_t memberLen = uint32_t(BgzfHeaderLEN + zs.total_out + BgzfFooterLEN);
+	const uint32_t crc = crc32(crc32(0, NULL, 0), (const Bytef*)data, len);
+	memcpy(dst.data(), header, BgzfHeaderLEN);
+	dst[16] = char((memberLen - 1) & 0xFF);
+	dst[17] = char((memberLen - 1) >> 8);
+	char* footer = dst.data() + memberLen - BgzfFooterLEN;
+	for (BYTE i = 0; i < 4; i++) {
+		footer[i] = char(crc >> (8 * i));
+		footer[i + 4] = char(len >> (8 * i));
+	}
+	dst.resize(memberLen);
+	return true;
+}
+
+bool BgzfWriter::WriteBlocks(const char* data, size_t len)
+{
+	vector<string> blocks((len + BlockLen - 1) / BlockLen);
+	atomic<bool> success{ true };
+	auto compress = [&](size_t i) {
+		const size_t pos = i * BlockLen;
+		if (!CompressBlock(data + pos, uint32_t(min(size_t(BlockLen), len - pos)), blocks[i]))
+			success = false;
+	};
+
+#ifdef _MULTITHREAD
+	if (_pool)	_pool->Run(blocks.size(), compress);
+	else
+#endif
+		for (size_t i = 0; i < blocks.size(); i++)	compress(i);
+
+	if (!success)	return false;
+	for (const auto& block : blocks)
+		if (fwrite(block.data(), 1, block.size(), _file) != block.size())
+			return false;
+	return true;
+}
+
+size_t BgzfWriter::Write(const char* data, size_t len)
+{
+	size_t pos = 0;
+
+	// complete the incomplete block
+	if (_rest.size()) {
+		pos = min(len, BlockLen - _rest.size());
+		_rest.append(data, pos);
+		if (_rest.size() < BlockLen)	return len;
+		if (!WriteBlocks(_rest.data(), _rest.size()))	return 0;
+		_rest.clear();
+	}
+	// write full blocks directly
+	const size_t fullLen = (len - pos) / BlockLen * BlockLen;
+	if (fullLen && !WriteBlocks(data + pos, fullLen))	return 0;
+	_rest.assign(data + pos + fullLen, len - pos - fullLen);
+	return len;
+}
+
+int BgzfWriter::Close()
+{
+	// empty member as the end-of-file marker
+	static const BYTE eof[] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	bool success = !_rest.size() || WriteBlocks(_rest.data(), _rest.size());
+	success = fwrite(eof, 1, sizeof(eof), _file) == sizeof(eof) && success;
+	return fclose(_file) || !success ? EOF : 0;
+}
+
+/************************ BgzfWriter: end ************************/
+
+/************************ BgzfReader ************************/
+
+thrid BgzfReader::ThrCnt = 1;	// number of threads for inflating blocks
+
+bool BgzfReader::IsBgzf(const char* header)
+{
+	return header[0] == char(31) && header[1] == char(139) && header[2] == 8 && (header[3] & 4)	// gzip with extra field
+		&& header[10] == 6 && header[11] == 0 && header[12] == 'B' && header[13] == 'C' && header[14] == 2 && header[15] == 0;
+}
+
+int BgzfReader::ReadBlock(Block& block)
+{
+	char header[BgzfHeaderLEN];
+
+	const size_t len = fread(header, 1, BgzfHeaderLEN, _file);
+	if (!len)	return ferror(_file) ? -1 : 0;
+	if (len < BgzfHeaderLEN || !IsBgzf(header))	return -1;
+	const uint32_t memberLen = uint32_t(BYTE(header[16]) | BYTE(header[17]) << 8) + 1;
+	if (memberLen < BgzfHeaderLEN + BgzfFooterLEN)	return -1;
+
+	block.Data.resize(memberLen);
+	memcpy(block.Data.data(), header, BgzfHeaderLEN);
+	if (fread(block.Data.data() + BgzfHeaderLEN, 1, memberLen - BgzfHeaderLEN, _file) != memberLen - BgzfHeaderLEN)
+		return -1;
+	const BYTE* footer = (const BYTE*)block.Data.data() + memberLen - BgzfFooterLEN;
+	block.Len = footer[4] | footer[5] << 8 | footer[6] << 16 | uint32_t(footer[7]) << 24;
+	return block.Len <= 0x10000 ? 1 : -1;
+}
+
+bool BgzfReader::InflateBlock(const Block& block, char* dst)
+{
+	const uint32_t dataLen = uint32_t(block.Data.size()) - BgzfHeaderLEN - BgzfFooterLEN;
+	z_stream zs{};
+
+	if (inflateInit2(&zs, -15) != Z_OK)	return false;
+	zs.next_in = (Bytef*)block.Data.data() + BgzfHeaderLEN;
+	zs.avail_in = dataLen;
+	zs.next_out = (Bytef*)dst;
+	zs.avail_out = block.Len;
+	const int res = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+	if (res != Z_STREAM_END || zs.total_out != block.Len)	return false;
+
+	const BYTE* footer = (const BYTE*)block.Data.data() + BgzfHeaderLEN + dataLen;
+	return crc32(crc32(0, NULL, 0), (const Bytef*)dst, block.Len)
+		== (footer[0] | footer[1] << 8 | footer[2] << 16 | uint32_t(footer[3]) << 24);
+}
+
+int BgzfReader::Read(char* dst, uint32_t len)
+{
+	// the rest of partially consumed block
+	uint32_t readLen = min(len, uint32_t(_rest.size() - _restPos));
+	memcpy(dst, _rest.data() + _restPos, readLen);
+	_restPos += readLen;
+
+	while (readLen < len) {
+		// read blocks covering the remaining length; each block but the last one is inflated directly to dst
+		vector<Block> blocks;
+		vector<char*> dsts;			// block destinations
+		uint32_t pos = readLen;		// destination position
+		while (pos < len) {
+			blocks.emplace_back();
+			const int res = ReadBlock(blocks.back());
+			if (res < 0)	return -1;
+			if (!res) { blocks.pop_back(); break; }
+			if (!blocks.back().Len) { blocks.pop_back(); continue; }	// end-of-file marker
+			if (pos + blocks.back().Len > len) {	// the last block overflows dst
+				_rest.resize(blocks.back().Len);
+				dsts.push_back(_rest.data());
+			}
+			else
+				dsts.push_back(dst + pos);
+			pos += blocks.back().Len;
+		}
+		if (blocks.empty())	break;		// end of file
+
+		atomic<bool> success{ true };
+		auto inflate = [&](size_t i) { if (!InflateBlock(blocks[i], dsts[i]))	success = false; };
+#ifdef _MULTITHREAD
+		if (ThrCnt > 1 && blocks.size() > 1) {
+			if (!_pool)	_pool.reset(new WorkerPool(ThrCnt));
+			_pool->Run(blocks.size(), inflate);
+		}
+		else
+#endif
+			for (size_t i = 0; i < blocks.size(); i++)	inflate(i);
+		if (!success)	return -1;
+
+		if (pos > len) {				// copy the beginning of the last block
+			_restPos = uint32_t(_rest.size()) - (pos - len);
+			memcpy(dst + len - _restPos, _rest.data(), _restPos);
+			pos = len;
+		}
+		readLen = pos;
+	}
+	return int(readLen);
+}
+
+int BgzfReader::ReadNextBlock(string& data, uint64_t& offset)
+{
+	Block block;
+
+	offset = _ftelli64(_file);
+	const int res = ReadBlock(block);
+	if (res <= 0)	return res;
+	data.resize(block.Len);
+	return InflateBlock(block, data.data()) ? 1 : -1;
+}
+
+bool BgzfReader::Seek(uint64_t offset)
+{
+	Block block;
+
+	_rest.clear();
+	_restPos = 0;
+	if (_fseeki64(_file, offset >> 16, SEEK_SET))	return false;
+	const int res = ReadBlock(block);
+	if (res <= 0)	return !res;
+	_rest.resize(block.Len);
+	if (!InflateBlock(block, _rest.data()))	return false;
+	_restPos = min(uint32_t(offset & 0xFFFF), block.Len);
+	return true;
+}
+
+/************************ BgzfReader: end ************************/
+#endif	// _ZLIB
+
 /************************ TxtFile ************************/
+#ifdef __unix__
+bool TxtFile::MemMapping = false;	// true if uncompressed files should be read through the memory mapping
+#endif
+
 const char* modes[] = { "r", "w", "a+" };
 const char* bmodes[] = { "rb", "wb" };
 
@@ -96,8 +327,26 @@ bool TxtFile::SetBasic(const string& fName, eAction mode, void* fStream)
 #ifdef _ZLIB
 		if (IsZipped())
 			if (mode == eAction::READ_ANY)	SetError(Err::FZ_OPEN);
+			else if (mode == eAction::WRITE) {
+				if (FILE* file = fopen(fName.c_str(), bmodes[int(mode)]))
+					_stream = new BgzfWriter(file),
+					RaiseFlag(BGZF);
+				else
+					SetError(Err::F_OPEN);
+			}
 			else {
-				if (!(_stream = gzopen(fName.c_str(), bmodes[int(mode)])))
+				// BGZF stream is read by blocks, while plain gzip file is read serially
+				char header[BgzfHeaderLEN];
+				if (FILE* file = fopen(fName.c_str(), bmodes[int(mode)])) {
+					if (fread(header, 1, BgzfHeaderLEN, file) == BgzfHeaderLEN && BgzfReader::IsBgzf(header)
+					&& !fseek(file, 0, SEEK_SET)) {
+						_stream = new BgzfReader(file);
+						RaiseFlag(BGZF);
+					}
+					else
+						fclose(file);
+				}
+				if (!_stream && !(_stream = gzopen(fName.c_str(), bmodes[int(mode)])))
 					SetError(Err::F_OPEN);
 			}
 		else
@@ -142,7 +391,7 @@ TxtFile::TxtFile(const string& fName, eAction mode, bool msgFName, bool abortInv
 #ifdef _ZLIB
 	else if (IsZipped()) {				// existed file
 		auto size = size_t(FS::UncomressSize(f_name.c_str()));
-		if (size > 0) {
+		if (size > 0 || IsFlag(BGZF)) {		// BGZF keeps zero size in the end-of-file marker
 			// wrong uncompressed size: increase initial size four times
 			// since zip is too big to keep right size in archive
 			if (size <= _fSize)	_fSize <<= 2;
@@ -152,6 +401,16 @@ TxtFile::TxtFile(const string& fName, eAction mode, bool msgFName, bool abortInv
 		//_buffLen >>= 1;		// decrease block size twice because of allocating additional memory:
 							// 2x_buffLen for writing or 3x_buffLen for reading by gzip
 	}
+#endif
+#ifdef __unix__
+	if (MemMapping && _fSize && mode != eAction::WRITE && !IsZipped()) {
+		struct_stat64 st;
+		// pipes and other special files are read through the I/O buffer
+		if (!fstat(fileno((FILE*)_stream), &st) && S_ISREG(st.st_mode)) {
+			RaiseFlag(MAPPED);		// the I/O buffer will be set in TxtReader::MapBlock()
+			return;
+		}
+	}
 #endif
 	if (_fSize && _fSize < _buffLen)
 		if (mode != eAction::WRITE)
@@ -162,7 +421,7 @@ TxtFile::TxtFile(const string& fName, eAction mode, bool msgFName, bool abortInv
 	if (!CreateIOBuff())	return;
 
 #ifdef ZLIB_NEW
-	if (IsZipped() && gzbuffer((gzFile)_stream, _buffLen) == -1)
+	if (IsZipped() && !IsFlag(BGZF) && gzbuffer((gzFile)_stream, _buffLen) == -1)
 		SetError(Err::FZ_MEM);
 #endif
 }
@@ -181,7 +440,14 @@ TxtFile::TxtFile(const TxtFile& file) : _flag(file._flag)
 TxtFile::~TxtFile()
 {
 	if (IsClone())	return;
-	if (_buff)		delete[] _buff;
+	if (_buff && !IsMapped())	delete[] _buff;
+#ifdef _ZLIB
+	if (IsFlag(BGZF)) {
+		unique_ptr<BgzfStream> stream((BgzfStream*)_stream);
+		if (stream->Close())	SetError(Err::F_CLOSE);
+	}
+	else
+#endif
 	if (_stream &&
 #ifdef _ZLIB
 		IsZipped() ? gzclose((gzFile)_stream) :
@@ -202,11 +468,96 @@ void TxtFile::SetError(Err::eCode code, const string& senderSpec, const string&
 
 /************************ TxtReader ************************/
 
+#ifdef _MULTITHREAD
+BYTE TxtReader::ReadAheadBlkCnt = 0;	// number of blocks read in advance by the background thread
+
+TxtReader::ReadAhead::ReadAhead(function<int(char*, bufflen)> read, bufflen blockLen, BYTE blockCnt) :
+	_read(read), _blockLen(blockLen), _blocks(blockCnt)
+{
+	for (auto& b : _blocks)
+		b.Data.reset(new char[blockLen]);
+	_thread = thread(&ReadAhead::Run, this);
+}
+
+TxtReader::ReadAhead::~ReadAhead()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_cv.notify_all();
+	_thread.join();
+}
+
+void TxtReader::ReadAhead::Run()
+{
+	unique_lock<mutex> lock(_mutex);
+	while (!_eof) {
+		_cv.wait(lock, [this] { return _stop || _readyCnt < _blocks.size(); });
+		if (_stop)	break;
+		Block& b = _blocks[_tail];
+		lock.unlock();
+		const int len = _read(b.Data.get(), _blockLen);	// the free block is not shared
+		lock.lock();
+		if (len < 0)	_error = true;
+		b.Len = len < 0 ? 0 : bufflen(len);
+		b.Pos = 0;
+		_eof = bufflen(len) != _blockLen;
+		if (++_tail == _blocks.size())	_tail = 0;
+		_readyCnt++;
+		_cv.notify_all();
+	}
+}
+
+int TxtReader::ReadAhead::Read(char* dst, bufflen len)
+{
+	bufflen res = 0;
+
+	while (res < len) {
+		unique_lock<mutex> lock(_mutex);
+		_cv.wait(lock, [this] { return _readyCnt || _eof; });
+		if (!_readyCnt)
+			return _error ? -1 : int(res);
+		Block& b = _blocks[_head];
+		lock.unlock();
+		// the filled block is not changed by the reading thread until it is released
+		const bufflen cnt = min(len - res, b.Len - b.Pos);
+		memcpy(dst + res, b.Data.get() + b.Pos, cnt);
+		res += cnt;
+		if ((b.Pos += cnt) == b.Len) {		// release block
+			lock.lock();
+			if (_error && _readyCnt == 1)	return -1;
+			if (++_head == _blocks.size())	_head = 0;
+			_readyCnt--;
+			_cv.notify_all();
+		}
+	}
+	return int(res);
+}
+#endif	// _MULTITHREAD
+
 TxtReader::TxtReader(const string& fName, eAction mode,
-	BYTE cntRecLines, bool msgFName, bool abortInvalid) :
+	BYTE cntRecLines, bool msgFName, bool abortInvalid, size_t startPos, size_t endPos, size_t lineBase) :
+	TxtFile(fName, mode, msgFName, abortInvalid),
 	_recLineCnt(cntRecLines),
-	TxtFile(fName, mode, msgFName, abortInvalid)
+	_readPos(startPos),
+	_endPos(endPos),
+	_lineBase(lineBase)
 {
+	if (startPos && IsGood()) {		// reading a part of file
+		assert(!IsZipped());
+#ifdef __unix__
+		if (IsMapped())	_mapPos = startPos;
+		else
+#endif
+			if (_fseeki64((FILE*)_stream, startPos, SEEK_SET))
+				SetError(Err::F_READ);
+	}
+#ifdef _MULTITHREAD
+	if (ReadAheadBlkCnt && IsGood() && !IsMapped() && !_endPos && Length() >= _buffLen)
+		_readAhead.reset(new ReadAhead(
+			[this](char* dst, bufflen len) { return RawRead(dst, len); }, _buffLen, ReadAheadBlkCnt));
+#endif
 	if (Length() && ReadBlock(0) >= 0) {		// read first block
 		_linesLen = new reclen[cntRecLines];	// nonempty file: set lines buffer
 		DefineLF();
@@ -215,30 +566,129 @@ TxtReader::TxtReader(const string& fName, eAction mode,
 		RaiseFlag(ENDREAD);						// empty file
 }
 
-int TxtReader::ReadBlock(const bufflen offset)
+TxtReader::~TxtReader()
+{
+#ifdef _MULTITHREAD
+	_readAhead.reset();		// stop reading thread before closing the stream
+#endif
+	if (_linesLen)	delete[] _linesLen;
+#ifdef __unix__
+	UnmapBlock();
+#endif
+}
+
+bool TxtReader::SeekTo(size_t pos)
 {
-	bufflen readLen;
+#ifdef _MULTITHREAD
+	_readAhead.reset();			// stop reading in advance from the previous position
+#endif
+#ifdef __unix__
+	if (IsMapped())	_mapPos = pos;
+	else
+#endif
 #ifdef _ZLIB
-	if (IsZipped()) {
-		int len = gzread((gzFile)_stream, _buff + offset, _buffLen - offset);
-		if (len < 0) { SetError(Err::F_READ); return -1; }
-		readLen = bufflen(len);
+	if (IsFlag(BGZF)) {
+		if (!((BgzfReader*)_stream)->Seek(pos))	SetError(Err::F_READ);
 	}
 	else
 #endif
-	{
-		readLen = bufflen(fread(_buff + offset, sizeof(char), _buffLen - offset, (FILE*)_stream));
-		if (readLen != _buffLen - offset && !feof((FILE*)_stream))
-		{ SetError(Err::F_READ); return -1; }
+	if (IsZipped() || _fseeki64((FILE*)_stream, pos, SEEK_SET))
+		SetError(Err::F_READ);
+	if (!IsGood())	return false;
+
+	_readPos = pos;
+	_recLen = 0;
+	_currRecPos = 0;
+	SetFlag(ENDREAD, false);
+#ifdef _MULTITHREAD
+	if (ReadAheadBlkCnt && !IsMapped() && !_endPos && Length() >= _buffLen)
+		_readAhead.reset(new ReadAhead(
+			[this](char* dst, bufflen len) { return RawRead(dst, len); }, _buffLen, ReadAheadBlkCnt));
+#endif
+	if (ReadBlock(0) <= 0)	RaiseFlag(ENDREAD);
+	return IsGood();
+}
+
+#ifdef __unix__
+int TxtReader::MapBlock()
+{
+	static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	const size_t pos = _mapPos + _currRecPos;	// file position of the new window
+	const size_t pageOffset = pos % pageSize;	// mmap() requires page-aligned file offset
+	const size_t endPos = _endPos ? _endPos : Length();
+	size_t len = endPos - pos;					// number of chars in the new window
+
+	UnmapBlock();
+	if (!len)	return 0;
+	if (len > MapBlockSize)	len = MapBlockSize;
+	// Reserve an additional anonymous zero page after the window,
+	// since the reading methods check the char next to the last readed one.
+	// Window is mapped privately because of the inserted '0' instead of TABs and LF.
+	_mapLen = pageOffset + len + pageSize;
+	_map = mmap(NULL, _mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (_map == MAP_FAILED
+	|| mmap(_map, pageOffset + len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+		fileno((FILE*)_stream), off_t(pos - pageOffset)) == MAP_FAILED) {
+		if (_map != MAP_FAILED)	munmap(_map, _mapLen);
+		_map = nullptr;
+		SetError(Err::F_READ);
+		return -1;
 	}
-	_readedLen = readLen + offset;
+	madvise(_map, pageOffset + len, MADV_SEQUENTIAL);
+
+	_buff = (char*)_map + pageOffset;
+	_mapPos = pos;
+	_readedLen = bufflen(len);
+	// the final window should look like a partially filled I/O buffer
+	_buffLen = _readedLen + bufflen(pos + len == endPos);
+	_currRecPos = 0;
+	return int(_readedLen);
+}
+
+void TxtReader::UnmapBlock()
+{
+	if (_map && !IsClone()) {
+		munmap(_map, _mapLen);
+		_map = nullptr;
+		_buff = NULL;
+	}
+}
+#endif
+
+int TxtReader::RawRead(char* dst, bufflen len)
+{
+	if (_endPos && _readPos + len > _endPos)	// reading a part of file
+		len = bufflen(_endPos - _readPos);
+#ifdef _ZLIB
+	if (IsFlag(BGZF))
+		return ((BgzfReader*)_stream)->Read(dst, len);
+	if (IsZipped())
+		return gzread((gzFile)_stream, dst, len);
+#endif
+	const bufflen readLen = bufflen(fread(dst, sizeof(char), len, (FILE*)_stream));
+	if (readLen != len && (!feof((FILE*)_stream) || ferror((FILE*)_stream)))
+		return -1;
+	_readPos += readLen;
+	return int(readLen);
+}
+
+int TxtReader::ReadBlock(const bufflen offset)
+{
+#ifdef __unix__
+	if (IsMapped())	return MapBlock();	// the remainder is kept since the window starts at the current record
+#endif
+	const int len =
+#ifdef _MULTITHREAD
+		_readAhead ? _readAhead->Read(_buff + offset, _buffLen - offset) :
+#endif
+		RawRead(_buff + offset, _buffLen - offset);
+	if (len < 0) { SetError(Err::F_READ); return -1; }
+	_readedLen = bufflen(len) + offset;
 	//#ifdef ZLIB_OLD
 		//if( _readTotal + _readedLen > _fSize )
 		//	_readedLen = _fSize - _readTotal;
 		//_readTotal += _readedLen;
 	//#endif
-	if (_readedLen != _buffLen && !IsZipped() && ferror((FILE*)_stream))
-	{ SetError(Err::F_READ); return -1; }
 	_currRecPos = 0;
 	return int(_readedLen);
 }
@@ -252,7 +702,8 @@ bool TxtReader::CompleteBlock(bufflen currLinePos, bufflen blankLineCnt)
 
 	blankLineCnt = _readedLen - _currRecPos - blankLineCnt;	// now length of unreaded remainder
 	// move remainder to the beginning of buffer; if length of unreaded remain = 0, skip moving
-	memmove(_buff, _buff + _currRecPos, blankLineCnt);
+	if (!IsMapped())
+		memmove(_buff, _buff + _currRecPos, blankLineCnt);
 	_recLen = 0;
 	if (!ReadBlock(blankLineCnt))
 	{ RaiseFlag(ENDREAD); return true; };
@@ -279,61 +730,26 @@ const char* TxtReader::GetNextRecord()
 
 	_recLen = 0;
 	for (BYTE rec = 0; rec < _recLineCnt; rec++)
-		for (char* buf = _buff + (i = currPos);; buf++, i++) {
-			if (*buf == LF) {
-				if (i == currPos) {				// LF marker is first in line
-					++currPos; ++blanklCnt;		// skip empty line
-					continue;
-				}
-			lf:	_recLen += (_linesLen[rec] = ++i - currPos);
-				currPos = i;
-				break;							// mext line in a record
-			}
+		for (i = currPos;;) {
+			i = bufflen(FindChars(_buff + i, _buff + _readedLen, LF, LF) - _buff);
 			if (i >= _readedLen) {	// check for oversize buffer
 				if (_readedLen != _buffLen && i > currPos)	// last record does not end with LF
 					goto lf;
 				if (CompleteBlock(currPos, blanklCnt))	return NULL;
-				currPos = blanklCnt = i = rec = 0;
-				buf = _buff;
+				currPos = blanklCnt = rec = 0;
+				i = 1;				// the first char of the moved record has been checked already
+				continue;
 			}
-		}
-	_currRecPos = currPos;			// next record position
-	_recCnt++;
-	return RealRecord();
-}
-
-const char* TxtReader::GetNextRecord(chrlen& counterN)
-{
-	if (IsFlag(ENDREAD))	return NULL;
-	assert(_recLineCnt == 1);
-
-	bufflen i, blanklCnt = 0;		// counter of empty lines
-	bufflen	currPos = _currRecPos;	// start position of current readed record
-	chrlen cntN = 0;				// local counter of 'N'; needs when buffer is oversized
-
-	_recLen = 0;
-	for (char* buf = _buff + (i = currPos);; buf++, i++) {
-		if (*buf == cN)		cntN++;
-		else if (*buf == LF) {
 			if (i == currPos) {				// LF marker is first in line
-				currPos++; blanklCnt++;		// skip empty line
+				++currPos; ++blanklCnt; ++i;	// skip empty line
 				continue;
 			}
-		lf:	_recLen += (*_linesLen = ++i - currPos);
+		lf:	_recLen += (_linesLen[rec] = ++i - currPos);
 			currPos = i;
-			break;
-		}
-		if (i >= _readedLen) {	// check for oversize buffer
-			if (_readedLen != _buffLen && i > currPos)	// last record does not end with LF
-				goto lf;
-			if (CompleteBlock(currPos, blanklCnt))	return NULL;
-			currPos = blanklCnt = i = cntN = 0;
-			buf = _buff;
+			break;							// mext line in a record
 		}
-	}
 	_currRecPos = currPos;			// next record position
 	_recCnt++;
-	counterN += cntN;
 	return RealRecord();
 }
 
@@ -347,28 +763,30 @@ char* TxtReader::GetNextRecord(short* const tabPos, const BYTE tabCnt)
 	BYTE tabInd = 1;				// index of TAB position in tabPos
 
 	_recLen = 0;
-	for (char* buf = _buff + (i = currPos);; buf++, i++) {
-		if (*buf == TAB) {
+	for (i = currPos;;) {
+		i = bufflen(FindChars(_buff + i, _buff + _readedLen, TAB, LF) - _buff);
+		if (i >= _readedLen) {	// check for oversize block
+			if (_readedLen != _buffLen && i > currPos)	// last record does not end with LF
+				goto lf;
+			if (CompleteBlock(currPos, blanklCnt))	return NULL;
+			currPos = blanklCnt = 0;
+			i = 1;				// the first char of the moved record has been checked already
+			tabInd = 1;
+			continue;
+		}
+		if (_buff[i] == TAB) {
 			if (tabInd < tabCnt)
 				tabPos[tabInd++] = short(i + 1 - currPos);
+			i++;
 		}
-		else if (*buf == LF) {
-			if (i == currPos) {				// LF marker is first in line
-				currPos++; blanklCnt++;		// skip empty line
-				continue;
-			}
+		else if (i == currPos) {		// LF marker is first in line
+			currPos++; blanklCnt++; i++;	// skip empty line
+		}
+		else {
 		lf:	_recLen += (*_linesLen = ++i - currPos);
 			currPos = i;
 			break;
 		}
-		if (i >= _readedLen) {	// check for oversize block
-			if (_readedLen != _buffLen && i > currPos)	// last record does not end with LF
-				goto lf;
-			if (CompleteBlock(currPos, blanklCnt))	return NULL;
-			currPos = blanklCnt = i = 0;
-			buf = _buff;
-			tabInd = 1;
-		}
 	}
 	_currRecPos = currPos;			// next record position
 	_recCnt++;
@@ -461,19 +879,25 @@ reclen TxtWriter::LineAddChars(const char* src, reclen len, bool addDelim)
 
 void TxtWriter::LineAddInt(LLONG v, bool addDelim)
 {
-	_lineBuffOffset += sprintf(_lineBuff + _lineBuffOffset, "%lld", v);
+	LineAddIntVal(v);
 	LineAddDelim(addDelim);
 }
 
 void TxtWriter::LineAddInts(ULONG v1, ULONG v2, bool addDelim)
 {
-	_lineBuffOffset += sprintf(_lineBuff + _lineBuffOffset, "%u%c%u", v1, _delim, v2);
+	LineAddIntVal(v1);
+	LineAddChar(_delim);
+	LineAddIntVal(v2);
 	LineAddDelim(addDelim);
 }
 
 void TxtWriter::LineAddUInts(chrlen v1, chrlen v2, chrlen v3, bool addDelim)
 {
-	_lineBuffOffset += sprintf(_lineBuff + _lineBuffOffset, "%u%c%u%c%u", v1, _delim, v2, _delim, v3);
+	LineAddIntVal(v1);
+	LineAddChar(_delim);
+	LineAddIntVal(v2);
+	LineAddChar(_delim);
+	LineAddIntVal(v3);
 	LineAddDelim(addDelim);
 }
 
@@ -493,13 +917,26 @@ void TxtWriter::LineAddUInts(chrlen v1, chrlen v2, chrlen v3, bool addDelim)
 void TxtWriter::SetFloatFractDigits(BYTE fractDigitsCnt)
 {
 	assert(fractDigitsCnt < 10);
-	_formatFloat[0][3] = std::to_string(fractDigitsCnt)[0];	// "%4.2f"
-	_floatBuffLen = 4 + fractDigitsCnt;
+	_fractDigitsCnt = fractDigitsCnt;
 }
 
 void TxtWriter::LineAddFloat(float val, bool addDelim)
 {
-	_lineBuffOffset += std::snprintf(_lineBuff + _lineBuffOffset, _floatBuffLen, _formatFloat[val == 0].c_str(), val);
+	const reclen minWidth = 4;	// minimum width of nonzero value, as in "%4.2f" format
+	char* const dst = _lineBuff + _lineBuffOffset;
+	// zero is printed without fractional part, as in "%1.f" format
+	const auto res = to_chars(dst, _lineBuff + _lineBuffLen, double(val),
+		chars_format::fixed, val == 0 ? 0 : _fractDigitsCnt);
+	if (res.ec != errc())	ThrowLineOverflow();
+	char* end = res.ptr;
+	const reclen len = reclen(end - dst);
+
+	if (val != 0 && len < minWidth) {	// right-justify
+		memmove(dst + minWidth - len, dst, len);
+		memset(dst, SPACE, minWidth - len);
+		end = dst + minWidth;
+	}
+	_lineBuffOffset = reclen(end - _lineBuff);
 	LineAddDelim(addDelim);
 }
 
@@ -566,7 +1003,7 @@ void TxtWriter::Write() const
 	size_t res =
 #ifdef _ZLIB
 		IsZipped() ?
-		gzwrite((gzFile)_stream, _buff, (unsigned int)_currRecPos) :
+		((BgzfWriter*)_stream)->Write(_buff, _currRecPos) :
 #endif
 		fwrite(
 			_buff,
@@ -850,41 +1287,30 @@ void FaReader::DefRgnMaker::CloseAddGaps(chrlen cLen)
 	_defRgns.Write();
 }
 
-void FaReader::CountN(chrlen startPos, reclen NCnt)
+void FaReader::AddNRuns()
 {
-	if (NCnt == 1)	return;
-
 	const char* line = Line();
-	const reclen lineLen = LineLength();
-	reclen nCnt = 0, iN;				// local count N, first N index
-	bool firstN = true;
-
-	for (chrlen i = startPos; i < lineLen; i++)
-		if (line[i] == cN) {					// some 'N' subsequence begins?
-			nCnt++;
-			if (firstN) { iN = i; firstN = false; }
-		}
-		else if (nCnt)						// is current subsequence finished?
-			if (nCnt == 1) {					// was it a single 'N'?
-				nCnt = 0; NCnt--; firstN = true;
-			}
-			else {							// continuous 'N' sequence?
-				_rgnMaker->AddGap(iN, nCnt);	// add complete 'N' subsequence
-				CountN(i++, NCnt - nCnt);	// search in the rest of line
-				break;
-			}
+	const char* end = line + LineLength();
+	const char* p = FindLetter(line, end, 'n', true);
+
+	if (p == end)	return;
+	if (p == line && FindLetter(p, end, 'n', false) == end) {
+		_rgnMaker->AddGap(0, LineLength());		// the whole line is filled by 'N'
+		return;
+	}
+	for (const char* pEnd; p < end; p = FindLetter(pEnd, end, 'n', true)) {
+		pEnd = FindLetter(p + 1, end, 'n', false);
+		if (pEnd == end)	break;				// the run at the end of line is not closed
+		if (pEnd - p > 1)	_rgnMaker->AddGap(chrlen(p - line), chrlen(pEnd - p));	// single 'N' is skipped
+	}
 }
 
 const char* FaReader::GetLineWitnNControl()
 {
-	chrlen nCnt = 0;	// number of 'N' in line
-	const char* line = GetNextRecord(nCnt);
+	const char* line = GetNextRecord();
 	if (line) {
-		const chrlen len = LineLength();
-		if (nCnt)
-			if (nCnt == len)	_rgnMaker->AddGap(0, nCnt);	// the whole line is filled by 'N'
-			else			CountN(0, nCnt);
-		_rgnMaker->AddLineLen(len);
+		AddNRuns();
+		_rgnMaker->AddLineLen(LineLength());
 	}
 	return line;
 }
@@ -911,6 +1337,108 @@ FaReader::FaReader(const string& fName, ChromDefRegions* rgns) : TxtReader(fName
 
 /************************ end of class FaReader ************************/
 
+/************************ FaIndex ************************/
+
+const string FaIndex::Ext = ".fai";	// index file extension
+
+bool FaIndex::Read(const string& iName)
+{
+	struct_stat64 st, ist;
+
+	if (_stat64(iName.c_str(), &ist) || _stat64(_fName.c_str(), &st) || ist.st_mtime < st.st_mtime)
+		return false;
+	ifstream file(iName);
+	uint64_t len;
+
+	if (!(file >> _name >> len >> _offset >> _lineBases >> _lineWidth)
+		|| !_lineBases || _lineWidth < _lineBases || len > CHRLEN_MAX)
+		return _lineBases = 0, false;
+	_len = chrlen(len);
+	return true;
+}
+
+void FaIndex::Build()
+{
+	FILE* file = fopen(_fName.c_str(), "rb");
+	if (!file)	Err(Err::F_OPEN, _fName.c_str()).Throw();
+
+	const size_t buffLen = 1 << 20;
+	unique_ptr<char[]> buff(new char[buffLen]);
+	const char* errMsg = nullptr;
+	uint64_t pos = 0, len = 0;				// current file position, sequence length
+	uint32_t lineLen = 0, lineBases = 0;	// current line width and number of nucleotides
+	bool header = true, lastLine = false, done = false;
+
+	// closes the current line; only the last line may be shorter than the first one
+	auto closeLine = [&]() {
+		if (!_lineWidth)	_lineBases = lineBases, _lineWidth = lineLen;
+		else if (lastLine || lineBases > _lineBases || (lineBases == _lineBases && lineLen != _lineWidth))
+			errMsg = "different line length";
+		lastLine = lineBases < _lineBases;
+		len += lineBases;
+		lineLen = lineBases = 0;
+	};
+
+	for (size_t readLen; !done && !errMsg && (readLen = fread(buff.get(), 1, buffLen, file)); )
+		for (size_t i = 0; i < readLen && !done && !errMsg; i++, pos++) {
+			const char c = buff[i];
+			if (header) {
+				if (c == LF)	header = false, _offset = pos + 1;
+				else if (pos)	_name.push_back(c);
+				else if (c != '>')	errMsg = "wrong format";
+			}
+			else if (c == '>' && !lineLen)	done = true;	// the next sequence is out of index
+			else {
+				lineLen++;
+				if (c == LF)	closeLine();
+				else if (c != CR)	lineBases++;
+			}
+		}
+	const bool readErr = ferror(file);
+	fclose(file);
+	if (readErr)	Err(Err::F_READ, _fName.c_str()).Throw();
+	if (lineLen && !errMsg)	closeLine();		// the last line without LF
+	if (errMsg)	Err(errMsg, _fName).Throw();
+	if (!_lineBases)	Err(Err::F_EMPTY, _fName.c_str()).Throw();
+	if (len > CHRLEN_MAX)	Err("too long sequence", _fName).Throw();
+
+	const auto it = find_if(_name.begin(), _name.end(), [](char c) { return isspace(c); });
+	_name.erase(it, _name.end());			// the name is the first word of the header
+	_len = chrlen(len);
+}
+
+void FaIndex::Write(const string& iName) const
+{
+	ofstream file(iName);
+	file << _name << TAB << _len << TAB << _offset << TAB << _lineBases << TAB << _lineWidth << LF;
+}
+
+FaIndex::FaIndex(const string& fName, const string& sName, bool build) : _fName(fName)
+{
+	if (FS::HasGzipExt(fName)
+		|| Read(fName + Ext) || (sName.size() && Read(sName)) || !build)
+		return;
+	Build();
+	if (sName.size())	Write(sName);
+}
+
+void FaIndex::Fetch(const Region& rgn, char* dst) const
+{
+	if (rgn.Invalid())	return;
+	const uint64_t beg = FilePos(rgn.Start);
+	string buff(size_t(FilePos(rgn.End - 1) + 1 - beg), cNULL);
+	FILE* file = fopen(_fName.c_str(), "rb");
+
+	if (!file)	Err(Err::F_OPEN, _fName.c_str()).Throw();
+	const bool res = !_fseeki64(file, beg, SEEK_SET) && fread(buff.data(), 1, buff.size(), file) == buff.size();
+	fclose(file);
+	if (!res)	Err(Err::F_READ, _fName.c_str()).Throw();
+	for (const char c : buff)
+		if (c != LF && c != CR)	*dst++ = c;
+}
+
+/************************ FaIndex: end ************************/
+
 #endif	// no _FQSTATN
 
 // Creates new instance with read buffer belonges to aggregated file: constructor for concatenating.
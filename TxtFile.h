@@ -2,11 +2,18 @@
 TxtFile.h
 Provides read|write basic bioinfo text files functionality
 2014 Fedor Naumenko (fedor.naumenko@gmail.com)
-Last modified: 06/23/2024
+Last modified: 10/16/2026
 ***********************************************************/
 #pragma once
 
 #include "common.h"
+#ifdef _TXT_WRITER
+#include <charconv>		// to_chars()
+#endif
+#ifdef _MULTITHREAD
+#include <thread>
+#include <condition_variable>
+#endif
 
 // Number of basics file's reading|writing buffer blocks.
 // Should be less than 2047 because of ULONG type of block size variable.
@@ -112,11 +119,133 @@ public:
 
 } fformat;
 
+#ifdef _ZLIB
+// 'BgzfStream' is a base class for reading/writing BGZF (blocked gzip) stream:
+//	a sequence of independent gzip members, each holding up to 64 Kb of data, terminated by an empty member.
+//	The stream is readable by any gzip reader and allows random access by the block offsets.
+class BgzfStream
+{
+protected:
+	FILE*	_file;
+
+	BgzfStream(FILE* file) : _file(file) {}
+
+public:
+	virtual ~BgzfStream() {}
+
+	// Completes and closes file
+	//	@returns: 0 if success, otherwise EOF
+	virtual int Close() { return fclose(_file); }
+};
+
+// 'BgzfWriter' writes BGZF stream.
+//	Accumulated full blocks are compressed in parallel and written in order.
+class BgzfWriter : public BgzfStream
+{
+	string	_rest;		// uncompressed data of the incomplete block
+#ifdef _MULTITHREAD
+	unique_ptr<WorkerPool> _pool;	// compressing threads; null for serial compressing
+#endif
+
+	// Compresses blocks and writes them to file
+	//	@param data: uncompressed data
+	//	@param len: length of data; all blocks except the last one are full
+	//	@returns: true if success
+	bool WriteBlocks(const char* data, size_t len);
+
+public:
+	static const uint32_t BlockLen = 0xff00;	// maximum length of uncompressed block data, as in BAM
+	static thrid ThrCnt;	// number of threads for compressing blocks; 1 for serial compressing
+
+	// Compresses one block into single gzip member
+	//	@param data: uncompressed data
+	//	@param len: length of data; should not exceed BlockLen
+	//	@param dst: compressed block
+	//	@returns: true if success
+	static bool CompressBlock(const char* data, uint32_t len, string& dst);
+
+	// Creates instance upon opened file
+	BgzfWriter(FILE* file) : BgzfStream(file)
+	{
+#ifdef _MULTITHREAD
+		if (ThrCnt > 1)	_pool.reset(new WorkerPool(ThrCnt));
+#endif
+	}
+
+	// Writes data; full blocks are written immediately, the rest is kept
+	//	@param data: uncompressed data
+	//	@param len: length of data
+	//	@returns: number of written chars or 0 if unsuccess writing
+	size_t Write(const char* data, size_t len);
+
+	// Writes the rest and the end-of-file marker, and closes file
+	//	@returns: 0 if success, otherwise EOF
+	int Close() override;
+};
+
+// 'BgzfReader' reads BGZF stream.
+//	Compressed blocks covering the requested length are read on the caller's thread,
+//	inflated in parallel directly into the destination and taken in order, as for BAM.
+class BgzfReader : public BgzfStream
+{
+	// compressed block
+	struct Block {
+		string	 Data;		// compressed member
+		uint32_t Len;		// uncompressed length
+	};
+
+	string	_rest;				// uncompressed data of the partially consumed block
+	uint32_t _restPos = 0;		// number of consumed chars in the partially consumed block
+#ifdef _MULTITHREAD
+	unique_ptr<WorkerPool> _pool;	// inflating threads; created on the first multi-block reading
+#endif
+
+	// Reads the next compressed block
+	//	@param block: filled block
+	//	@returns: 1 if success, 0 at the end of file, -1 if unsuccess reading or invalid block
+	int ReadBlock(Block& block);
+
+	// Inflates block
+	//	@param block: compressed block
+	//	@param dst: destination of block.Len chars
+	//	@returns: true if success
+	static bool InflateBlock(const Block& block, char* dst);
+
+public:
+	static thrid ThrCnt;	// number of threads for inflating blocks; 1 for serial inflating
+
+	// Returns true if the data starts with BGZF member header
+	//	@param header: data of 18 chars at least
+	static bool IsBgzf(const char* header);
+
+	// Creates instance upon opened file
+	BgzfReader(FILE* file) : BgzfStream(file) {}
+
+	// Reads and inflates data
+	//	@param dst: destination buffer
+	//	@param len: number of chars to read
+	//	@returns: number of readed chars, which is less than len at the end of file; -1 if unsuccess reading
+	int Read(char* dst, uint32_t len);
+
+	// Reads and inflates the next block
+	//	@param data: block data
+	//	@param offset: file offset of the block
+	//	@returns: 1 if success, 0 at the end of file, -1 if unsuccess reading or invalid block
+	int ReadNextBlock(string& data, uint64_t& offset);
+
+	// Sets the reading position
+	//	@param offset: virtual offset: block file offset shifted by 16 bits, plus offset within uncompressed block
+	//	@returns: true if success
+	bool Seek(uint64_t offset);
+};
+#endif	// _ZLIB
+
 class TxtFile
 	/*
 	 * Basic class 'TxtFile' implements a fast buffered serial (stream) reading/writing text files
 	 * (in Windows and Linux standart).
 	 * Supports reading/writing zipped (gz) files.
+	 * In Linux uncompressed regular files can be read through the memory mapping (see MemMapping).
 	 * Optimised for huge files.
 	 * Restriction: the default size of buffer, setting as NUMB_BLK * BasicBlockSize,
 	 * should be bigger than the longest line in file. Otherwise file become invalid,
@@ -150,6 +279,8 @@ protected:
 		PRNAME	  = 0x20,	// print file name in exception's message; for Reading mode
 		MTHREAD	  = 0x40,	// file in multithread mode: needs to be locked while writing
 		CLONE	  = 0x80,	// file is a clone
+		MAPPED	  = 0x100,	// file is memory-mapped; for Reading mode
+		BGZF	  = 0x200,	// file is BGZF stream
 	};
 
 	using bufflen = uint32_t;
@@ -164,7 +295,7 @@ private:
 	mutable short _flag;	// bitwise storage for signs included in eFlag
 
 protected:
-	void* _stream;			// FILE* (for unzipped file) or gzFile (for zipped file)
+	void* _stream;			// FILE* (for unzipped file), gzFile (for zipped file) or BgzfStream* (for BGZF file)
 	char* _buff;			// basic I/O (read/write) buffer
 	bufflen	_buffLen;		// the length of the basic I/O buffer
 	mutable bufflen _currRecPos;	// start position of the last readed/writed record in the block
@@ -177,6 +308,7 @@ protected:
 	bool IsFlag(eFlag f)	const { return _flag & f; }
 	bool IsZipped()			const { return _flag & ZIPPED; }
 	bool IsClone()			const { return _flag & CLONE; }
+	bool IsMapped()			const { return _flag & MAPPED; }
 
 	// *** 3 methods used by TxtReader only
 
@@ -259,22 +391,98 @@ protected:
 	void ThrowExcept(Err::eCode code) const { Err(code, CondFileName().c_str()).Throw(); }
 
 public:
+#ifdef __unix__
+	// True if uncompressed regular files should be read through the memory mapping.
+	// Zipped files and pipes are always read through the I/O buffer.
+	static bool MemMapping;
+#endif
+
 	// Returns file name
 	const string& FileName() const { return _fName; }
 };
 
 // 'TxtReader' represents TxtFile for reading
-//	orrectly reads records even if the latter does not end with LF (CR,LF) character (s)
+//	�orrectly reads records even if the latter does not end with LF (CR,LF) character (s)
 class TxtReader : public TxtFile
 {
+#ifdef _MULTITHREAD
+	// 'ReadAhead' reads (and unzips) the next blocks of file in a background thread
+	// while the current block is being parsed
+	class ReadAhead
+	{
+		struct Block {
+			unique_ptr<char[]> Data;
+			bufflen	Len = 0;		// number of readed chars
+			bufflen	Pos = 0;		// number of already consumed chars
+		};
+
+		const function<int(char*, bufflen)> _read;	// raw reading function
+		const bufflen	_blockLen;
+		vector<Block>	_blocks;		// ring of blocks
+		BYTE	_head = 0;				// index of the block that is consumed
+		BYTE	_tail = 0;				// index of the block that is filled
+		BYTE	_readyCnt = 0;			// number of filled blocks
+		bool	_eof = false;			// true if file is readed to the end
+		bool	_error = false;			// true if reading is failed
+		bool	_stop = false;			// true if the thread should be stopped
+		mutex	_mutex;
+		condition_variable _cv;
+		thread	_thread;
+
+		// Fills the blocks in a loop until the file is finished
+		void Run();
+
+	public:
+		// Creates instance and starts reading thread
+		//	@param read: function reading the given number of chars; returns -1 if unsuccess reading
+		//	@param blockLen: length of block
+		//	@param blockCnt: number of blocks read in advance
+		ReadAhead(function<int(char*, bufflen)> read, bufflen blockLen, BYTE blockCnt);
+
+		// Stops reading thread
+		~ReadAhead();
+
+		// Copies the next readed chars to the buffer, waiting for them if necessary
+		//	@param dst: destination buffer
+		//	@param len: number of chars to copy
+		//	@returns: number of copied chars, which is less than len at the end of file; -1 if unsuccess reading
+		int Read(char* dst, bufflen len);
+	};
+
+	unique_ptr<ReadAhead> _readAhead;	// background reader; NULL in serial mode
+#endif
 	reclen	_recLen = 0;			// the length of record with LF marker
 	bufflen	_readedLen = 0;			// number of actually readed chars in block
 	reclen* _linesLen = nullptr;	// array of lengths of lines in a record
 	BYTE	_recLineCnt;			// number of lines in a record
+	size_t	_readPos = 0;			// file position of the next raw reading
+	size_t	_endPos = 0;			// file position to stop reading at, or 0 to read up to the end
+	size_t	_lineBase = 0;			// number of lines before the start reading position
+#ifdef __unix__
+	constexpr static bufflen MapBlockSize = bufflen(256 * 1024 * 1024);	// 256 Mb
+
+	void*	_map = nullptr;			// start of the mapped window
+	size_t	_mapLen = 0;			// length of the mapped window including guard page
+	size_t	_mapPos = 0;			// file position of the first char in the I/O buffer
+
+	// Maps the next file window beginning from the current record position;
+	// the I/O buffer points to this position after mapping
+	//	@returns: 0 if file is finished; -1 if unsuccess mapping; otherwhise number of mapped chars
+	int MapBlock();
+
+	// Unmaps current file window
+	void UnmapBlock();
+#endif
 
 	// Raises ENDREAD sign an return NULL
 	//char* ReadingEnded()		  { RaiseFlag(ENDREAD); return NULL; }
 
+	// Reads chars from the file stream
+	//	@param dst: destination buffer
+	//	@param len: number of chars to read
+	//	@returns: number of readed chars, which is less than len at the end of file; -1 if unsuccess reading
+	int RawRead(char* dst, bufflen len);
+
 	// Reads next block
 	//	@param offset: shift of start reading position
 	//	@returns: 0 if file is finished; -1 if unsuccess reading; otherwhise number of readed chars
@@ -298,7 +506,7 @@ class TxtReader : public TxtFile
 
 	// Gets line number
 	//	@param lineInd: index of line in a record
-	size_t LineNumber(BYTE lineInd) const { return (_recCnt - 1) * _recLineCnt + lineInd + 1; }
+	size_t LineNumber(BYTE lineInd) const { return _lineBase + (_recCnt - 1) * _recLineCnt + lineInd + 1; }
 
 protected:
 	// Constructs an TxtReader instance: allocates buffers, opens an assigned file.
@@ -307,9 +515,29 @@ protected:
 	//	@param cntRecLines: number of lines in a record
 	//	@param msgFName: true if file name should be printed in an exception's message
 	//	@param abortInvalid: true if invalid instance should be completed by throwing exception
-	TxtReader(const string& fName, eAction mode, BYTE cntRecLines, bool msgFName = true, bool abortInvalid = true);
+	//	@param startPos: file position to start reading from; uncompressed file only
+	//	@param endPos: file position to stop reading at, or 0 to read up to the end; uncompressed file only
+	//	@param lineBase: number of lines before startPos; used to report line numbers
+	TxtReader(const string& fName, eAction mode, BYTE cntRecLines, bool msgFName = true, bool abortInvalid = true,
+		size_t startPos = 0, size_t endPos = 0, size_t lineBase = 0);
+
+#ifdef _MULTITHREAD
+	// Constructs a clone of an existing instance; clone does not read in advance
+	//	@param file: opened file which is cloned
+	TxtReader(const TxtReader& file) :
+		TxtFile(file),
+		_recLen(file._recLen),
+		_readedLen(file._readedLen),
+		_linesLen(file._linesLen),
+		_recLineCnt(file._recLineCnt) {}
+#endif
 
-	~TxtReader() { if (_linesLen)	delete[] _linesLen; }
+	~TxtReader();
+
+	// Sets the reading position and reads the block from it; the records counter is not changed
+	//	@param pos: file position, or virtual offset for BGZF file; should be the beginning of the line
+	//	@returns: true if success
+	bool SeekTo(size_t pos);
 
 	// Returns record without control
 	char* RealRecord() const { return _buff + _currRecPos - _recLen; }
@@ -321,11 +549,6 @@ protected:
 	//	@returns: pointer to line or NULL if no more lines
 	const char* GetNextRecord();
 
-	// Reads one-line N-controlled record
-	//	@param counterN: counter of 'N'
-	//	@returns: pointer to line or NULL if no more lines
-	const char* GetNextRecord(chrlen& counterN);
-
 	// Reads one-line tab-controlled record
 	//	@param tabPos: TAB's positions array that should be filled
 	//	@param cntTabs: maximum number of TABS in TAB's positions array
@@ -351,6 +574,12 @@ protected:
 	void RollBackRecord(char sep);
 
 public:
+#ifdef _MULTITHREAD
+	// Number of blocks read in advance by the background thread; 0 means reading in the parsing thread.
+	// Used for files which do not fit in one block.
+	static BYTE ReadAheadBlkCnt;
+#endif
+
 	// Gets length of current reading record including LF marker
 	//	Returns 0 after RollBackLastRecord() invoke.
 	reclen RecordLength() const { return _recLen; }
@@ -397,8 +626,7 @@ private:
 	char*	_lineBuff = NULL;		// line write buffer; for writing mode only
 	reclen	_lineBuffLen = 0;		// length of line write buffer in writing mode, otherwise 0
 	reclen	_lineBuffOffset = 0;	// current shift from the _buffLine; replaced by #define!!!
-	BYTE	_floatBuffLen = 6;		// length of buffer where the resulting float as string is stored
-	string	_formatFloat[2]{ "%4.2f", "%1.f" };	// format string for converting float to string
+	BYTE	_fractDigitsCnt = 2;	// number of digits in the fractional part of float as string
 #ifdef _MULTITHREAD
 	// === total counter of writed records
 	size_t* _totalRecCnt;	// pointer to total counter of writed records; for clone only
@@ -413,6 +641,18 @@ private:
 	//	@param addDelim: if true then adds delimiter to the current position in the line write buffer and increases current position
 	void LineAddDelim(bool addDelim) { if (addDelim) LineAddChar(_delim); }
 
+	// Throws exception about line write buffer overflow
+	void ThrowLineOverflow() const { Err(Err::F_BIGLINE, CondFileName().c_str()).Throw(); }
+
+	// Adds integral value to the current position of the line write buffer without delimiter
+	//	@param val: value to be set
+	template<typename T>
+	void LineAddIntVal(T val) {
+		const auto res = to_chars(_lineBuff + _lineBuffOffset, _lineBuff + _lineBuffLen, val);
+		if (res.ec != errc())	ThrowLineOverflow();
+		_lineBuffOffset = reclen(res.ptr - _lineBuff);
+	}
+
 	// Allocates memory for write line buffer with checking
 	//	@param len: size of the allocated buffer
 	//	@returns: true if successful
@@ -638,6 +878,19 @@ public:
 			Init(_fType, estLineCnt);
 	}
 
+	// Creates new instance for reading a part of uncompressed file
+	//	@param fName: name of file
+	//	@param type: file bioinfo type
+	//	@param startPos: file position to start reading from; should be the beginning of the line
+	//	@param endPos: file position to stop reading at; should be the beginning of the line or the end of file
+	//	@param lineBase: number of lines before startPos; used to report line numbers
+	//	@param abortInvalid: true if invalid instance should be completed by throwing exception
+	TabReader(const string& fName, FT::eType type, size_t startPos, size_t endPos, size_t lineBase, bool abortInvalid = true)
+		: TxtReader(fName, eAction::READ, 1, false, abortInvalid, startPos, endPos, lineBase), _fType(type)
+	{
+		if (IsGood())	Init(_fType, false);
+	}
+
 #if defined _ISCHIP && defined  _MULTITHREAD
 	// Creates a clone of TabReader class (for multithreading file recording)
 	// Clone is a copy of opened file with its own buffer for writing only
@@ -848,12 +1101,9 @@ class FaReader : public TxtReader
 	const char* (FaReader::* _pGetLine)();	// pointer to the 'GetNextLine' method
 	unique_ptr<DefRgnMaker> _rgnMaker;		// chrom defined regions store
 
-	// Searches 'N' subsequence in the current line beginning from the start position
-	// and adds complete 'N' subsequence to _rgnMaker
-	//	@param startPos: starting line reading position
-	//	@param NCnt: number of 'N' in the line beginning from the start position
-	//	@returns: true if line trimming is complete, false for single 'N'
-	void CountN(chrlen startPos, reclen NCnt);
+	// Adds 'N' subsequences of the current line to _rgnMaker: the whole line filled by 'N',
+	// or subsequences of 2 'N' at least which are closed within the line. 'N' is case insensitive.
+	void AddNRuns();
 
 	// Reads line and set it as current with def filling regions
 	// Since method scans the line, it takes no overhead expenses to do this.
@@ -875,4 +1125,56 @@ public:
 	void CLoseReading() { if (_rgnMaker) _rgnMaker->CloseAddGaps(_cLen); }
 };
 
+// 'FaIndex' represents samtools-compatible index '.fai' of the first sequence of uncompressed FA file,
+//	and provides direct reading of sequence regions
+class FaIndex
+{
+	string	 _fName;			// FA file name
+	string	 _name;				// sequence name
+	chrlen	 _len = 0;			// sequence length
+	uint64_t _offset = 0;		// file offset of the first nucleotide
+	uint32_t _lineBases = 0;	// number of nucleotides per line
+	uint32_t _lineWidth = 0;	// number of chars per line, including line terminator
+
+	// Initializes instance from index file, if it exists and is not older than FA file
+	//	@param iName: index file name
+	//	@returns: true if success
+	bool Read(const string& iName);
+
+	// Initializes instance by scanning FA file
+	void Build();
+
+	// Saves instance; the failure is ignored
+	//	@param iName: index file name
+	void Write(const string& iName) const;
+
+	// Returns file offset of the nucleotide
+	//	@param pos: nucleotide position
+	uint64_t FilePos(chrlen pos) const { return _offset + uint64_t(pos / _lineBases) * _lineWidth + pos % _lineBases; }
+
+public:
+	static const string Ext;	// index file extension
+
+	// Initializes instance from index file placed besides FA file or in the service directory,
+	//	otherwise builds index and saves it in the service directory. Compressed FA file is not indexed.
+	//	@param fName: FA file name
+	//	@param sName: index file name in the service directory, or empty
+	//	@param build: if true then build index when it is absent
+	FaIndex(const string& fName, const string& sName, bool build = true);
+
+	// Returns true if instance is initialized
+	bool IsValid() const { return _lineBases; }
+
+	// Returns sequence name
+	const string& Name() const { return _name; }
+
+	// Returns sequence length
+	chrlen Length() const { return _len; }
+
+	// Reads region nucleotides directly by the file seeking; thread-safe
+	//	@param rgn: region within the sequence
+	//	@param dst: destination buffer of rgn.Length() chars at least
+	void Fetch(const Region& rgn, char* dst) const;
+};
+
 #endif	// no _FQSTATN
@@ -0,0 +1,59 @@
+/**********************************************************
+TxtScan.cpp
+Last modified: 10/16/2026
+***********************************************************/
+
+#include "TxtScan.h"
+#ifdef _SIMD_X86
+#include <emmintrin.h>	// SSE2
+#ifdef _MSC_VER
+#include <intrin.h>		// _BitScanForward()
+#endif
+#endif
+
+const char* FindCharsScalar(const char* p, const char* end, char c1, char c2)
+{
+	for (; p < end; p++)
+		if (*p == c1 || *p == c2)	break;
+	return p;
+}
+
+const char* FindLetterScalar(const char* p, const char* end, char c, bool eq)
+{
+	for (; p < end; p++)
+		if (((*p | 0x20) == c) == eq)	break;
+	return p;
+}
+
+#ifdef _SIMD_X86
+#ifdef _MSC_VER
+static inline BYTE TrailZeroCnt(UINT mask) { unsigned long i; _BitScanForward(&i, mask); return BYTE(i); }
+#else
+static inline BYTE TrailZeroCnt(UINT mask) { return BYTE(__builtin_ctz(mask)); }
+#endif
+
+const char* FindCharsSSE2(const char* p, const char* end, char c1, char c2)
+{
+	const __m128i v1 = _mm_set1_epi8(c1), v2 = _mm_set1_epi8(c2);
+
+	for (; p + sizeof(__m128i) <= end; p += sizeof(__m128i)) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)p);
+		const UINT mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+		if (mask)	return p + TrailZeroCnt(mask);
+	}
+	return FindCharsScalar(p, end, c1, c2);
+}
+
+const char* FindLetterSSE2(const char* p, const char* end, char c, bool eq)
+{
+	const __m128i vc = _mm_set1_epi8(c), vCase = _mm_set1_epi8(0x20);
+	const UINT inv = eq ? 0 : 0xFFFF;		// inverts mask to search for other chars
+
+	for (; p + sizeof(__m128i) <= end; p += sizeof(__m128i)) {
+		const __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i*)p), vCase);	// to lower case
+		const UINT mask = UINT(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vc))) ^ inv;
+		if (mask)	return p + TrailZeroCnt(mask);
+	}
+	return FindLetterScalar(p, end, c, eq);
+}
+#endif	// _SIMD_X86
@@ -0,0 +1,54 @@
+/**********************************************************
+TxtScan.h
+Provides chars scanning kernels used by TxtReader and FaReader; internal header
+Last modified: 10/16/2026
+***********************************************************/
+#pragma once
+
+#include "common.h"
+
+#if defined __x86_64__ || defined _M_X64
+#define _SIMD_X86
+#endif
+
+// Scanning kernels used by the TxtReader::GetNextRecord() overloads and FaReader 'N' control.
+// Each x86-64 processor has SSE2, so SSE2 kernels are used there; other processors use scalar kernels.
+// AVX2 kernels are not used: they were slower on short ABED and FA lines (see bench/ScanBench.cpp).
+
+// Returns pointer to the first c1 or c2 char in the range, or end of range if there are none
+//	@param p: start of the range
+//	@param end: end of the range (exclusive)
+const char* FindCharsScalar(const char* p, const char* end, char c1, char c2);
+
+// Returns pointer to the first char in the range which is equal (or not equal) to the letter in any case,
+//	or end of range if there are none
+//	@param p: start of the range
+//	@param end: end of the range (exclusive)
+//	@param c: lower case letter
+//	@param eq: if true then search for the letter, otherwise for any other char
+const char* FindLetterScalar(const char* p, const char* end, char c, bool eq);
+
+#ifdef _SIMD_X86
+const char* FindCharsSSE2(const char* p, const char* end, char c1, char c2);
+const char* FindLetterSSE2(const char* p, const char* end, char c, bool eq);
+#endif
+
+// Returns pointer to the first c1 or c2 char in the range by the best kernel
+inline const char* FindChars(const char* p, const char* end, char c1, char c2)
+{
+#ifdef _SIMD_X86
+	return FindCharsSSE2(p, end, c1, c2);
+#else
+	return FindCharsScalar(p, end, c1, c2);
+#endif
+}
+
+// Returns pointer to the first char equal (or not equal) to the letter by the best kernel
+inline const char* FindLetter(const char* p, const char* end, char c, bool eq)
+{
+#ifdef _SIMD_X86
+	return FindLetterSSE2(p, end, c, eq);
+#else
+	return FindLetterScalar(p, end, c, eq);
+#endif
+}
@@ -13,21 +13,165 @@
 
 #include <algorithm>
 #include "BGZF.h"
+#ifdef _MULTITHREAD
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 using namespace BamTools;
 using std::string;
 using std::min;
 
+#ifdef _MULTITHREAD
+namespace BamTools {
+
+// compressed blocks are read in advance on the caller's thread,
+// de-compressed by the pool threads and taken back in the file order
+struct BgzfInflatePool {
+
+    struct Block {
+        char*    CompressedBlock;
+        char*    UncompressedBlock;
+        int      CompressedLength;      // 0 on EOF, -1 on read failure
+        int      UncompressedLength;    // -1 on de-compression failure
+        uint64_t Address;
+        bool     IsDone;
+    };
+
+    std::vector<Block> Blocks;          // ring of read-ahead blocks
+    size_t   Head;                      // index of the next block to take
+    size_t   Count;                     // number of read-ahead blocks
+    bool     IsEOF;                     // true if EOF or read failure has been reached
+    bool     IsStopped;
+    std::deque<Block*> Tasks;           // blocks waiting for de-compression
+    std::vector<std::thread> Threads;
+    std::mutex Mutex;
+    std::condition_variable TaskReady;
+    std::condition_variable BlockDone;
+
+    BgzfInflatePool(int threadCount);
+    ~BgzfInflatePool(void);
+
+    // discards read-ahead blocks
+    void Clear(void);
+    // reads blocks in advance up to the ring size
+    void Fill(BgzfData& bgzf);
+    // waits for the next block in file order
+    Block& Front(void);
+    // releases the next block
+    void Pop(void) { Head = (Head + 1) % Blocks.size(); --Count; }
+    // de-compresses blocks until stopped
+    void Run(void);
+};
+
+BgzfInflatePool::BgzfInflatePool(int threadCount)
+    : Blocks(4 * threadCount)
+    , Head(0)
+    , Count(0)
+    , IsEOF(false)
+    , IsStopped(false)
+{
+    for ( Block& block : Blocks ) {
+        block.CompressedBlock   = new char[MAX_BLOCK_SIZE];
+        block.UncompressedBlock = new char[DEFAULT_BLOCK_SIZE];
+        block.IsDone = true;
+    }
+    for ( int i = 0; i < threadCount; ++i )
+        Threads.emplace_back(&BgzfInflatePool::Run, this);
+}
+
+BgzfInflatePool::~BgzfInflatePool(void) {
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        IsStopped = true;
+    }
+    TaskReady.notify_all();
+    for ( std::thread& thread : Threads ) thread.join();
+    for ( Block& block : Blocks ) {
+        delete[] block.CompressedBlock;
+        delete[] block.UncompressedBlock;
+    }
+}
+
+void BgzfInflatePool::Clear(void) {
+    std::unique_lock<std::mutex> lock(Mutex);
+    for ( Block* block : Tasks ) block->IsDone = true;
+    Tasks.clear();
+    // wait for the blocks being de-compressed: their buffers are in use
+    BlockDone.wait(lock, [this] {
+        for ( size_t i = 0; i < Count; ++i )
+            if ( !Blocks[(Head + i) % Blocks.size()].IsDone ) return false;
+        return true;
+    });
+    Head  = Count = 0;
+    IsEOF = false;
+}
+
+void BgzfInflatePool::Fill(BgzfData& bgzf) {
+    bool isTask = false;
+    while ( !IsEOF && Count < Blocks.size() ) {
+        Block& block = Blocks[(Head + Count++) % Blocks.size()];
+        block.Address = ftell(bgzf.Stream);
+        block.CompressedLength = bgzf.ReadCompressedBlock(block.CompressedBlock);
+        if ( block.CompressedLength <= 0 ) {
+            IsEOF = true;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(Mutex);
+        block.IsDone = false;
+        Tasks.push_back(&block);
+        isTask = true;
+    }
+    if ( isTask ) TaskReady.notify_all();
+}
+
+BgzfInflatePool::Block& BgzfInflatePool::Front(void) {
+    Block& block = Blocks[Head];
+    std::unique_lock<std::mutex> lock(Mutex);
+    BlockDone.wait(lock, [&block] { return block.IsDone; });
+    return block;
+}
+
+void BgzfInflatePool::Run(void) {
+    while ( true ) {
+        Block* block;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            TaskReady.wait(lock, [this] { return IsStopped || !Tasks.empty(); });
+            if ( IsStopped ) return;
+            block = Tasks.front();
+            Tasks.pop_front();
+        }
+        block->UncompressedLength = BgzfData::InflateBlock(block->CompressedBlock, block->CompressedLength,
+                                                           block->UncompressedBlock, DEFAULT_BLOCK_SIZE);
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            block->IsDone = true;
+        }
+        BlockDone.notify_all();
+    }
+}
+
+} // namespace BamTools
+#endif // _MULTITHREAD
+
 BgzfData::BgzfData(void)
     : UncompressedBlockSize(DEFAULT_BLOCK_SIZE)
     , CompressedBlockSize(MAX_BLOCK_SIZE)
     , BlockLength(0)
     , BlockOffset(0)
     , BlockAddress(0)
+    , NextBlockAddress(0)
     , IsOpen(false)
     , IsWriteOnly(false)
     , Stream(NULL)
     , UncompressedBlock(NULL)
     , CompressedBlock(NULL)
+#ifdef _MULTITHREAD
+    , InflatePool(NULL)
+#endif
 {
     try {
         CompressedBlock   = new char[CompressedBlockSize];
@@ -40,6 +184,9 @@ BgzfData::BgzfData(void)
 
 // destructor
 BgzfData::~BgzfData(void) {
+#ifdef _MULTITHREAD
+    delete InflatePool;
+#endif
     if( CompressedBlock )   { delete[] CompressedBlock;   }
     if( UncompressedBlock ) { delete[] UncompressedBlock; }
 }
@@ -50,6 +197,9 @@ void BgzfData::Close(void) {
 	// skip if file not open, otherwise set flag
     if ( !IsOpen ) return;
     IsOpen = false;
+#ifdef _MULTITHREAD
+    if ( InflatePool ) InflatePool->Clear();
+#endif
 
     // flush the current BGZF block
     if ( IsWriteOnly ) FlushBlock();
@@ -183,15 +333,20 @@ void BgzfData::FlushBlock(void) {
 
 // de-compresses the current block
 int BgzfData::InflateBlock(const int& blockLength) {
+    return InflateBlock(CompressedBlock, blockLength, UncompressedBlock, UncompressedBlockSize);
+}
+
+// de-compresses the block
+int BgzfData::InflateBlock(const char* compressedBlock, const int& blockLength, char* uncompressedBlock, unsigned int uncompressedBlockSize) {
 
-    // Inflate the block in m_BGZF.CompressedBlock into m_BGZF.UncompressedBlock
+    // Inflate the block in compressedBlock into uncompressedBlock
     z_stream zs;
     zs.zalloc    = NULL;
     zs.zfree     = NULL;
-    zs.next_in   = (Bytef*)CompressedBlock + 18;
+    zs.next_in   = (Bytef*)compressedBlock + 18;
     zs.avail_in  = blockLength - 16;
-    zs.next_out  = (Bytef*)UncompressedBlock;
-    zs.avail_out = UncompressedBlockSize;
+    zs.next_out  = (Bytef*)uncompressedBlock;
+    zs.avail_out = uncompressedBlockSize;
 
     int status = inflateInit2(&zs, GZIP_WINDOW_BITS);
     if (status != Z_OK) {
@@ -279,7 +434,7 @@ int BgzfData::Read(char* data, const unsigned int dataLength) {
    }
 
    if ( BlockOffset == BlockLength ) {
-       BlockAddress = ftell(Stream);
+       BlockAddress = NextBlockAddress;
        BlockOffset  = 0;
        BlockLength  = 0;
    }
@@ -287,59 +442,151 @@ int BgzfData::Read(char* data, const unsigned int dataLength) {
    return numBytesRead;
 }
 
+// skips BGZF data without copying
+int BgzfData::Skip(const unsigned int dataLength) {
+
+   unsigned int numBytesSkipped = 0;
+   while (numBytesSkipped < dataLength) {
+
+       int bytesAvailable = BlockLength - BlockOffset;
+       if ( bytesAvailable <= 0 ) {
+           if (!ReadBlock()) return -1; 
+           bytesAvailable = BlockLength - BlockOffset;
+           if (bytesAvailable <= 0) break;
+       }
+
+       int skipLength = min( (int)(dataLength-numBytesSkipped), bytesAvailable );
+       BlockOffset     += skipLength;
+       numBytesSkipped += skipLength;
+   }
+
+   if ( BlockOffset == BlockLength ) {
+       BlockAddress = NextBlockAddress;
+       BlockOffset  = 0;
+       BlockLength  = 0;
+   }
+
+   return numBytesSkipped;
+}
+
 // reads a BGZF block
 bool BgzfData::ReadBlock(void) {
 
-    char    header[BLOCK_HEADER_LENGTH];
+#ifdef _MULTITHREAD
+    if ( InflatePool ) return ReadInflatedBlock();
+#endif
     int64_t blockAddress = ftell(Stream);
 
-    int count = int(fread(header, 1, sizeof(header), Stream));
-    if (count == 0) {
+    int blockLength = ReadCompressedBlock(CompressedBlock);
+    if (blockLength == 0) {
         BlockLength = 0;
+        NextBlockAddress = blockAddress;
         return true;
     }
+    if (blockLength < 0) return false;
+
+    int count = InflateBlock(blockLength);
+    if (count < 0) { 
+      printf("BGZF ERROR: read block failed - could not decompress block data\n");
+      return false;
+    }
+
+    if ( BlockLength != 0 )
+        BlockOffset = 0;
+
+    BlockAddress = blockAddress;
+    NextBlockAddress = blockAddress + blockLength;
+    BlockLength  = count;
+    return true;
+}
+
+// reads a compressed BGZF block, returns block length, 0 on EOF or -1 on failure
+int BgzfData::ReadCompressedBlock(char* compressedBlock) {
+
+    int count = int(fread(compressedBlock, 1, BLOCK_HEADER_LENGTH, Stream));
+    if (count == 0) return 0;
 
-    if (count != sizeof(header)) {
+    if (count != BLOCK_HEADER_LENGTH) {
         printf("BGZF ERROR: read block failed - could not read block header\n");
-        return false;
+        return -1;
     }
 
-    if (!BgzfData::CheckBlockHeader(header)) {
+    if (!BgzfData::CheckBlockHeader(compressedBlock)) {
         printf("BGZF ERROR: read block failed - invalid block header\n");
-        return false;
+        return -1;
     }
 
-    int blockLength = BgzfData::UnpackUnsignedShort(&header[16]) + 1;
-    char* compressedBlock = CompressedBlock;
-    memcpy(compressedBlock, header, BLOCK_HEADER_LENGTH);
+    int blockLength = BgzfData::UnpackUnsignedShort(&compressedBlock[16]) + 1;
     int remaining = blockLength - BLOCK_HEADER_LENGTH;
 
     count = int(fread(&compressedBlock[BLOCK_HEADER_LENGTH], 1, remaining, Stream));
     if (count != remaining) {
         printf("BGZF ERROR: read block failed - could not read data from block\n");
-        return false;
+        return -1;
     }
+    return blockLength;
+}
 
-    count = InflateBlock(blockLength);
-    if (count < 0) { 
+#ifdef _MULTITHREAD
+// takes the next BGZF block decompressed in advance
+bool BgzfData::ReadInflatedBlock(void) {
+
+    InflatePool->Fill(*this);
+    BgzfInflatePool::Block& block = InflatePool->Front();
+
+    // EOF or failure block is kept to be reported again on the next calls
+    if (block.CompressedLength == 0) {
+        BlockLength = 0;
+        NextBlockAddress = block.Address;
+        return true;
+    }
+    if (block.CompressedLength < 0) return false;
+
+    if (block.UncompressedLength < 0) {
       printf("BGZF ERROR: read block failed - could not decompress block data\n");
       return false;
     }
 
+    // exchange buffers instead of copying
+    std::swap(UncompressedBlock, block.UncompressedBlock);
+
     if ( BlockLength != 0 )
         BlockOffset = 0;
 
-    BlockAddress = blockAddress;
-    BlockLength  = count;
+    BlockAddress = block.Address;
+    NextBlockAddress = block.Address + block.CompressedLength;
+    BlockLength  = block.UncompressedLength;
+
+    // read the next block instead of the taken one
+    InflatePool->Pop();
+    InflatePool->Fill(*this);
     return true;
 }
 
+// sets number of threads decompressing blocks in advance (0 or 1 to decompress on the caller's thread)
+void BgzfData::SetThreadCount(int threadCount) {
+
+    if ( InflatePool ) {
+        delete InflatePool;
+        InflatePool = NULL;
+        // return the file pointer from the read-ahead blocks
+        if ( IsOpen && fseek(Stream, long(NextBlockAddress), SEEK_SET) != 0 )
+            printf("BGZF ERROR: unable to seek in file\n");
+    }
+    if ( threadCount > 1 && !IsWriteOnly )
+        InflatePool = new BgzfInflatePool(threadCount);
+}
+#endif
+
 // seek to position in BGZF file
 bool BgzfData::Seek(int64_t position) {
 
     int     blockOffset  = (position & 0xFFFF);
     int64_t blockAddress = (position >> 16) & 0xFFFFFFFFFFFFLL;
 
+#ifdef _MULTITHREAD
+    if ( InflatePool ) InflatePool->Clear();
+#endif
     if (fseek(Stream, long(blockAddress), SEEK_SET) != 0) {
         printf("BGZF ERROR: unable to seek in file\n");
         return false;
@@ -347,6 +594,7 @@ bool BgzfData::Seek(int64_t position) {
 
     BlockLength  = 0;
     BlockAddress = blockAddress;
+    NextBlockAddress = blockAddress;
     BlockOffset  = blockOffset;
     return true;
 }
@@ -67,6 +67,11 @@ const int BLOCK_FOOTER_LENGTH = 8;
 const int MAX_BLOCK_SIZE      = 65536;
 const int DEFAULT_BLOCK_SIZE  = 65536;
 
+#ifdef _MULTITHREAD
+// pool of threads inflating the read-ahead blocks (defined in BGZF.cpp)
+struct BgzfInflatePool;
+#endif
+
 struct BgzfData {
 
     // ---------------------------------
@@ -77,11 +82,15 @@ struct BgzfData {
     unsigned int BlockLength;
     unsigned int BlockOffset;
     uint64_t BlockAddress;
+    uint64_t NextBlockAddress;
     bool     IsOpen;
     bool     IsWriteOnly;
     FILE*    Stream;
     char*    UncompressedBlock;
     char*    CompressedBlock;
+#ifdef _MULTITHREAD
+    BgzfInflatePool* InflatePool;
+#endif
 
     // ---------------------------------
     // constructor & destructor
@@ -98,12 +107,18 @@ struct BgzfData {
     bool Open(const std::string& filename, const char* mode);
     // reads BGZF data into a byte buffer
     int Read(char* data, const unsigned int dataLength);
+    // skips BGZF data without copying
+    int Skip(const unsigned int dataLength);
     // seek to position in BGZF file
     bool Seek(int64_t position);
     // get file position in BGZF file
     int64_t Tell(void);
     // writes the supplied data into the BGZF buffer
     unsigned int Write(const char* data, const unsigned int dataLen);
+#ifdef _MULTITHREAD
+    // sets number of threads decompressing blocks in advance (0 or 1 to decompress on the caller's thread)
+    void SetThreadCount(int threadCount);
+#endif
 
     // ---------------------------------
     // internal methods
@@ -116,10 +131,18 @@ struct BgzfData {
     int InflateBlock(const int& blockLength);
     // reads a BGZF block
     bool ReadBlock(void);
+    // reads a compressed BGZF block, returns block length, 0 on EOF or -1 on failure
+    int ReadCompressedBlock(char* compressedBlock);
+#ifdef _MULTITHREAD
+    // takes the next BGZF block decompressed in advance
+    bool ReadInflatedBlock(void);
+#endif
     
     // ---------------------------------
     // static 'utility' methods
     
+    // de-compresses the block
+    static int InflateBlock(const char* compressedBlock, const int& blockLength, char* uncompressedBlock, unsigned int uncompressedBlockSize);
     // checks BGZF block header
     static inline bool CheckBlockHeader(char* header);
     // packs an unsigned integer into the specified buffer
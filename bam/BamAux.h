@@ -53,6 +53,8 @@ const int BAM_CREF_SKIP   = 3;
 const int BAM_CSOFT_CLIP  = 4;
 const int BAM_CHARD_CLIP  = 5;
 const int BAM_CPAD        = 6;
+const int BAM_CEQUAL      = 7;
+const int BAM_CDIFF       = 8;
 const int BAM_CIGAR_SHIFT = 4;
 const int BAM_CIGAR_MASK  = ((1 << BAM_CIGAR_SHIFT) - 1);
 
@@ -175,6 +177,33 @@ struct BamAlignment {
              };
 };
 
+// 'core' alignment data, decoded without any heap allocation and reused for each alignment
+struct BamAlignmentCore {
+
+    // Queries against alignment flags
+    public:
+        bool IsPaired(void) const        { return ( (AlignmentFlag & 1)  != 0 ); }	// Returns true if alignment part of paired-end read
+        bool IsReverseStrand(void) const { return ( (AlignmentFlag & 16) != 0 ); }	// Returns true if alignment mapped to reverse strand
+
+    // Additional data access methods
+    public:
+        int GetEndPosition(void) const { return EndPosition; }	// Returns alignment end position, based on starting position and CIGAR operations
+
+    // Data members
+    public:
+        char         Name[256];         // Read name; BAM limits its length (including '\0') by 255
+        int32_t      Length;            // Query length
+        int32_t      RefID;             // ID number for reference sequence
+        int32_t      Position;          // Position (0-based) where alignment starts
+        int32_t      EndPosition;       // Position where alignment ends: start + length of M/D/N/=/X CIGAR operations
+        uint16_t     Bin;               // Bin in BAM file where this alignment resides
+        uint16_t     MapQuality;        // Mapping quality score
+        uint32_t     AlignmentFlag;     // Alignment bit-flag
+        int32_t      MateRefID;         // ID number for reference sequence where alignment's mate was aligned
+        int32_t      MatePosition;      // Position (0-based) where alignment's mate starts
+        int32_t      InsertSize;        // Mate-pair insert size
+};
+
 // ----------------------------------------------------------------
 // Auxiliary data structs & typedefs
 
@@ -338,7 +367,7 @@ int BamAlignment::GetEndPosition(bool usePadded) const {
     std::vector<CigarOp>::const_iterator cigarEnd  = CigarData.end();
     for ( ; cigarIter != cigarEnd; ++cigarIter) {
 	const char cigarType = (*cigarIter).Type;
-	if ( cigarType == 'M' || cigarType == 'D' || cigarType == 'N' ) {
+	if ( cigarType == 'M' || cigarType == 'D' || cigarType == 'N' || cigarType == '=' || cigarType == 'X' ) {
 	    alignEnd += (*cigarIter).Length;
 	} 
         else if ( usePadded && cigarType == 'I' ) {
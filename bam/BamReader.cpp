@@ -84,7 +84,8 @@ struct BamReader::BamReaderPrivate {
 
     // access alignment data
     bool GetNextAlignment(BamAlignment& bAlignment);
-    bool GetNextAlignmentCore(BamAlignment& bAlignment);
+    template<typename Alignment>
+    bool GetNextAlignmentCore(Alignment& alignment);
 
     // access auxiliary data
     int GetReferenceID(const string& refName) const;
@@ -105,11 +106,14 @@ struct BamReader::BamReaderPrivate {
     // calculate file offset for first alignment chunk overlapping specified region
     int64_t GetOffset(std::vector<int64_t>& chunkStarts);
     // checks to see if alignment overlaps current region
-    RegionState IsOverlap(BamAlignment& bAlignment);
+    template<typename Alignment>
+    RegionState IsOverlap(const Alignment& bAlignment);
     // retrieves header text from BAM file
     void LoadHeaderData(void);
     // retrieves BAM alignment under file pointer
     bool LoadNextAlignment(BamAlignment& bAlignment);
+    // retrieves 'core' data of BAM alignment under file pointer
+    bool LoadNextAlignment(BamAlignmentCore& alignment);
     // builds reference data structure from BAM file
     void LoadReferenceData(void);
 
@@ -157,6 +161,9 @@ bool BamReader::Jump(int refID, int position) {
 }
 bool BamReader::Open(const string& filename, const string& indexFilename) { return d->Open(filename, indexFilename); }
 bool BamReader::Rewind(void) { return d->Rewind(); }
+#ifdef _MULTITHREAD
+void BamReader::SetThreadCount(int threadCount) { d->mBGZF.SetThreadCount(threadCount); }
+#endif
 bool BamReader::SetRegion(const BamRegion& region) { return d->SetRegion(region); }
 bool BamReader::SetRegion(const int& leftRefID, const int& leftBound, const int& rightRefID, const int& rightBound) {
     return d->SetRegion( BamRegion(leftRefID, leftBound, rightRefID, rightBound) );
@@ -165,6 +172,7 @@ bool BamReader::SetRegion(const int& leftRefID, const int& leftBound, const int&
 // access alignment data
 bool BamReader::GetNextAlignment(BamAlignment& bAlignment) { return d->GetNextAlignment(bAlignment); }
 bool BamReader::GetNextAlignmentCore(BamAlignment& bAlignment) { return d->GetNextAlignmentCore(bAlignment); }
+bool BamReader::GetNextAlignmentCore(BamAlignmentCore& alignment) { return d->GetNextAlignmentCore(alignment); }
 
 // access auxiliary data
 const string BamReader::GetHeaderText(void) const { return d->HeaderText; }
@@ -175,6 +183,10 @@ const std::string BamReader::GetFilename(void) const { return d->Filename; }
 
 // index operations
 bool BamReader::CreateIndex(void) { return d->CreateIndex(); }
+bool BamReader::OpenIndex(const string& indexFilename) {
+    d->IndexFilename = indexFilename;
+    return d->LoadIndex();
+}
 
 // -----------------------------------------------------
 // BamReaderPrivate implementation
@@ -543,7 +555,8 @@ bool BamReader::BamReaderPrivate::GetNextAlignment(BamAlignment& bAlignment) {
 // ** DOES NOT parse any character data (bases, qualities, tag data)
 //    these can be accessed, if necessary, from the supportData 
 // useful for operations requiring ONLY positional or other alignment-related information
-bool BamReader::BamReaderPrivate::GetNextAlignmentCore(BamAlignment& bAlignment) {
+template<typename Alignment>
+bool BamReader::BamReaderPrivate::GetNextAlignmentCore(Alignment& bAlignment) {
 
     // if valid alignment available
     if ( LoadNextAlignment(bAlignment) ) {
@@ -686,7 +699,8 @@ void BamReader::BamReaderPrivate::InsertLinearOffset(LinearOffsetVector& offsets
 
 // returns region state - whether alignment ends before, overlaps, or starts after currently specified region
 // this *internal* method should ONLY called when (at least) IsLeftBoundSpecified == true
-BamReader::BamReaderPrivate::RegionState BamReader::BamReaderPrivate::IsOverlap(BamAlignment& bAlignment) {
+template<typename Alignment>
+BamReader::BamReaderPrivate::RegionState BamReader::BamReaderPrivate::IsOverlap(const Alignment& bAlignment) {
     
     // --------------------------------------------------
     // check alignment start against right bound cutoff
@@ -1004,6 +1018,70 @@ bool BamReader::BamReaderPrivate::LoadNextAlignment(BamAlignment& bAlignment) {
     return true;
 }
 
+// retrieves 'core' data of BAM alignment under file pointer, without any heap allocation
+bool BamReader::BamReaderPrivate::LoadNextAlignment(BamAlignmentCore& alignment) {
+
+    // read in the 'block length' value and core alignment data, make sure the right size of data was read
+    char x[BT_SIZEOF_INT + BAM_CORE_SIZE];
+    if ( mBGZF.Read(x, sizeof(x)) != (signed int)sizeof(x) ) { return false; }
+
+    if ( IsBigEndian ) {
+        for ( unsigned int i = 0; i < sizeof(x); i+=sizeof(uint32_t) ) { 
+          SwapEndian_32p(&x[i]); 
+        }
+    }
+
+    const unsigned int blockLength = BgzfData::UnpackUnsignedInt(&x[0]);
+    if ( blockLength == 0 ) { return false; }
+    const char* core = &x[BT_SIZEOF_INT];
+
+    // set 'core' data
+    alignment.RefID    = BgzfData::UnpackSignedInt(&core[0]);  
+    alignment.Position = BgzfData::UnpackSignedInt(&core[4]);
+
+    unsigned int tempValue = BgzfData::UnpackUnsignedInt(&core[8]);
+    alignment.Bin        = tempValue >> 16;
+    alignment.MapQuality = tempValue >> 8 & 0xff;
+    const unsigned int nameLength = tempValue & 0xff;
+
+    tempValue = BgzfData::UnpackUnsignedInt(&core[12]);
+    alignment.AlignmentFlag = tempValue >> 16;
+    const unsigned int numCigarOps = tempValue & 0xffff;
+
+    alignment.Length       = BgzfData::UnpackSignedInt(&core[16]);
+    alignment.MateRefID    = BgzfData::UnpackSignedInt(&core[20]);
+    alignment.MatePosition = BgzfData::UnpackSignedInt(&core[24]);
+    alignment.InsertSize   = BgzfData::UnpackSignedInt(&core[28]);
+
+    // read in alignment name
+    if ( mBGZF.Read(alignment.Name, nameLength) != (signed int)nameLength ) { return false; }
+    alignment.Name[nameLength] = '\0';
+
+    // calculate end position by CIGAR ops, reading them in portions
+    uint32_t cigarData[64];
+    alignment.EndPosition = alignment.Position;
+    for ( unsigned int i = 0; i < numCigarOps; ) {
+        const unsigned int cnt = std::min(numCigarOps - i, (unsigned int)(sizeof(cigarData) / sizeof(uint32_t)));
+        if ( mBGZF.Read((char*)cigarData, cnt * 4) != (signed int)(cnt * 4) ) { return false; }
+        for ( unsigned int j = 0; j < cnt; ++j ) {
+            if ( IsBigEndian ) { SwapEndian_32(cigarData[j]); }
+            switch ( cigarData[j] & BAM_CIGAR_MASK ) {
+                case BAM_CMATCH:
+                case BAM_CDEL:
+                case BAM_CREF_SKIP:
+                case BAM_CEQUAL:
+                case BAM_CDIFF:
+                    alignment.EndPosition += cigarData[j] >> BAM_CIGAR_SHIFT;
+            }
+        }
+        i += cnt;
+    }
+
+    // skip sequence, qualities and tags
+    const unsigned int restLength = blockLength - BAM_CORE_SIZE - nameLength - numCigarOps * 4;
+    return mBGZF.Skip(restLength) == (signed int)restLength;
+}
+
 // loads reference data from BAM file
 void BamReader::BamReaderPrivate::LoadReferenceData(void) {
 
@@ -45,6 +45,10 @@ class BamReader {
         bool Open(const std::string& filename, const std::string& indexFilename = "");
         // returns file pointer to beginning of alignments
         bool Rewind(void);
+#ifdef _MULTITHREAD
+        // sets number of threads decompressing BGZF blocks in advance (0 or 1 to decompress on the caller's thread)
+        void SetThreadCount(int threadCount);
+#endif
         // sets a region of interest (with left & right bound reference/position)
         // attempts a Jump() to left bound as well
         // returns success/failure of Jump()
@@ -64,6 +68,11 @@ class BamReader {
         // useful for operations requiring ONLY positional or other alignment-related information
         bool GetNextAlignmentCore(BamAlignment& bAlignment);
 
+        // retrieves next available alignment core data into the reused record (returns success/fail)
+        // ** does not allocate memory, skips character data
+        // the fastest way to get positional information
+        bool GetNextAlignmentCore(BamAlignmentCore& alignment);
+
         // ----------------------
         // access auxiliary data
         // ----------------------
@@ -85,6 +94,8 @@ class BamReader {
 
         // creates index for BAM file, saves to file (default = bamFilename + ".bai")
         bool CreateIndex(void);
+        // loads index data from BAM index file (returns success/fail)
+        bool OpenIndex(const std::string& indexFilename);
 
     // private implementation
     private:
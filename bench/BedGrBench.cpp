@@ -0,0 +1,63 @@
+/**********************************************************
+BedGrBench.cpp
+Last modified: 10/16/2026
+Times BedGrWriter::WriteChromData on a generated coverage map
+against the former sprintf() formatting of the same lines.
+Build from the repo root:
+g++ -std=c++17 -O2 -D_ZLIB -D_MULTITHREAD -D_TXT_WRITER -include cmath -o bedgrbench bench/BedGrBench.cpp OrderedData.cpp TxtFile.cpp TxtScan.cpp ChromData.cpp common.cpp -lz -lpthread
+Run: ./bedgrbench [intervals count, default 10000000]
+Outputs bench.wig and bench.sprintf.bedgraph differ only by the track line.
+***********************************************************/
+
+#include "../OrderedData.h"
+#include <random>
+
+// Returns elapsed wall time in seconds
+static double Elapsed(const chrono::steady_clock::time_point& begin)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+// Writes cover as bedGraph lines by sprintf(), as TxtWriter did before
+//	@param fName: output file name
+//	@param cover: coverage map
+static void WriteBySprintf(const char* fName, const covmap& cover)
+{
+	FILE* file = fopen(fName, "wb");
+	vector<char> buff(1 << 20);
+	size_t len = 0;
+
+	for (auto it0 = cover.cbegin(), it = next(it0); it != cover.cend(); it0 = it++)
+		if (it0->second) {
+			len += sprintf(buff.data() + len, "chr1\t%u\t%u\t%u\n", it0->first, it->first, it0->second);
+			if (len > buff.size() - 64)	fwrite(buff.data(), 1, len, file), len = 0;
+		}
+	fwrite(buff.data(), 1, len, file);
+	fclose(file);
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t cnt = argc > 1 ? size_t(atoll(argv[1])) : 10000000;
+	mt19937 rnd(1);
+	covmap cover;
+	chrlen pos = 0;
+
+	for (size_t i = 0; i < cnt; i++)
+		cover.emplace_hint(cover.end(), pos += 1 + rnd() % 20, coval(i % 8 ? 1 + rnd() % 500 : 0));
+	cover.emplace_hint(cover.end(), pos + 1, 0);
+	printf("%zu intervals\n", cnt);
+
+	const TrackFields fields("bench", "bench", nullptr, LIGHT);
+	auto begin = chrono::steady_clock::now();
+	{
+		BedGrWriter writer(TOTAL, fields);
+		writer.WriteChromData(0, cover);
+	}
+	printf("WriteChromData%8.0f ms\n", Elapsed(begin) * 1000);
+
+	begin = chrono::steady_clock::now();
+	WriteBySprintf("bench.sprintf.bedgraph", cover);
+	printf("sprintf       %8.0f ms\n", Elapsed(begin) * 1000);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/**********************************************************
+ScanBench.cpp
+Last modified: 10/16/2026
+Times chars scanning kernels: FindChars on generated 6-column ABED lines as TxtReader does,
+and FindLetter on generated FA lines as FaReader 'N' control does.
+Build from the repo root:
+g++ -std=c++17 -O2 -include cmath -o scanbench bench/ScanBench.cpp TxtScan.cpp
+Run: ./scanbench [lines count, default 4000000] [repetitions, default 5]
+***********************************************************/
+
+#include "../TxtScan.h"
+#include <random>
+#include <chrono>
+
+typedef const char* (*FindCharsFn)(const char* p, const char* end, char c1, char c2);
+typedef const char* (*FindLetterFn)(const char* p, const char* end, char c, bool eq);
+
+// Generates ABED lines like 'chr12<TAB>123456<TAB>123506<TAB>r.12345<TAB>0<TAB>+<LF>'
+//	@param cnt: number of lines
+static string GenABED(size_t cnt)
+{
+	mt19937 rnd(1);
+	string s;
+	char line[64];
+
+	s.reserve(cnt * 40);
+	for (size_t i = 0; i < cnt; i++) {
+		const unsigned pos = rnd() % 200000000;
+		snprintf(line, sizeof(line), "chr%u\t%u\t%u\tr.%zu\t%u\t%c\n",
+			unsigned(1 + rnd() % 22), pos, pos + 50, i, unsigned(rnd() % 43), rnd() % 2 ? '+' : '-');
+		s += line;
+	}
+	return s;
+}
+
+// Generates FA lines of 60 nucleotides in both cases with rare 'N' runs and rare whole 'N' lines
+//	@param cnt: number of lines
+static string GenFA(size_t cnt)
+{
+	const char nts[] = "ACGTacgt";
+	mt19937 rnd(1);
+	string s;
+
+	s.reserve(cnt * 61);
+	for (size_t i = 0; i < cnt; i++) {
+		char line[60];
+		if (rnd() % 100 == 0)	memset(line, 'N', sizeof(line));
+		else {
+			for (char& c : line)	c = nts[rnd() % 8];
+			if (rnd() % 20 == 0)		// 'N' run within the line
+				memset(line + rnd() % 55, 'n', 1 + rnd() % 5);
+		}
+		s.append(line, sizeof(line)) += LF;
+	}
+	return s;
+}
+
+// Scans all lines as TxtReader::GetNextRecord(tabPos, tabCnt) does;
+// returns checksum of TAB positions and lines lengths to compare kernels' output
+//	@param findChars: tested kernel
+//	@param buff: scanned lines
+static size_t ScanLines(FindCharsFn findChars, const string& buff)
+{
+	const char* const end = buff.data() + buff.size();
+	short tabPos[6]{};
+	size_t sum = 0;
+
+	for (const char* p = buff.data(), *currPos = p; p < end; ) {
+		BYTE tabInd = 1;
+		for (;; p++) {
+			p = findChars(p, end, TAB, LF);
+			if (p == end || *p == LF)	break;
+			if (tabInd < 6)
+				tabPos[tabInd++] = short(p + 1 - currPos);
+		}
+		for (BYTE i = 1; i < tabInd; i++)	sum += tabPos[i];
+		sum += (p - currPos) << 8;		// line length
+		currPos = ++p;
+	}
+	return sum;
+}
+
+// Scans all lines for 'N' runs as FaReader::AddNRuns() does;
+// returns checksum of runs positions and lengths to compare kernels' output
+//	@param findLetter: tested kernel
+//	@param buff: scanned lines
+static size_t ScanNRuns(FindLetterFn findLetter, const string& buff)
+{
+	const char* const end = buff.data() + buff.size();
+	size_t sum = 0;
+
+	for (const char* line = buff.data(), *lineEnd; line < end; line = lineEnd + 1) {
+		lineEnd = (const char*)memchr(line, LF, end - line);
+		const char* p = findLetter(line, lineEnd, 'n', true);
+		if (p == lineEnd)	continue;
+		if (p == line && findLetter(p, lineEnd, 'n', false) == lineEnd) {
+			sum += lineEnd - line;
+			continue;
+		}
+		for (const char* pEnd; p < lineEnd; p = findLetter(pEnd, lineEnd, 'n', true)) {
+			pEnd = findLetter(p + 1, lineEnd, 'n', false);
+			if (pEnd == lineEnd)	break;
+			sum += ((p - line) << 8) + (pEnd - p);
+		}
+	}
+	return sum;
+}
+
+// Prints the best of repeated timing of the kernel
+//	@param title: kernel name
+//	@param scan: scanning function calling tested kernel
+//	@param buff: scanned lines
+//	@param reps: number of repetitions
+//	@param baseSum: reference checksum or 0 to set it
+template<typename F>
+static void Bench(const char* title, F scan, const string& buff, int reps, size_t& baseSum)
+{
+	double best = 0;
+	size_t sum = 0;
+
+	for (int r = 0; r < reps; r++) {
+		const auto begin = chrono::steady_clock::now();
+		sum = scan(buff);
+		const double t = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+		if (!r || t < best)	best = t;
+	}
+	if (!baseSum)	baseSum = sum;
+	printf("%-8s%8.1f ms%9.0f MB/s%s\n", title, best * 1000, buff.size() / best / 1e6,
+		sum == baseSum ? "" : "  OUTPUT DIFFERS");
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t cnt = argc > 1 ? size_t(atoll(argv[1])) : 4000000;
+	const int reps = argc > 2 ? atoi(argv[2]) : 5;
+	string buff = GenABED(cnt);
+	size_t sum = 0;
+	auto findChars = [](FindCharsFn fn) { return [fn](const string& b) { return ScanLines(fn, b); }; };
+	auto findLetter = [](FindLetterFn fn) { return [fn](const string& b) { return ScanNRuns(fn, b); }; };
+
+	printf("FindChars: %zu ABED lines, %.1f MB\n", cnt, buff.size() / 1e6);
+	Bench("scalar", findChars(FindCharsScalar), buff, reps, sum);
+#ifdef _SIMD_X86
+	Bench("SSE2", findChars(FindCharsSSE2), buff, reps, sum);
+#endif
+
+	buff = GenFA(cnt);
+	sum = 0;
+	printf("FindLetter: %zu FA lines, %.1f MB\n", cnt, buff.size() / 1e6);
+	Bench("scalar", findLetter(FindLetterScalar), buff, reps, sum);
+#ifdef _SIMD_X86
+	Bench("SSE2", findLetter(FindLetterSSE2), buff, reps, sum);
+#endif
+	return 0;
+}
@@ -688,6 +688,83 @@ bool	Mutex::_active;		// true if the mutex really should work
 mutex	Mutex::_mutexes[int(Mutex::eType::NONE)];
 
 /************************  end of class Mutex ************************/
+
+/************************  class WorkerPool ************************/
+
+WorkerPool::WorkerPool(thrid thrCnt)
+{
+	for (thrid i = 1; i < thrCnt; i++)
+		_threads.emplace_back(&WorkerPool::Work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stop = true;
+	}
+	_cvTask.notify_all();
+	for (auto& t : _threads)	t.join();
+}
+
+void WorkerPool::DoTasks()
+{
+	try {
+		for (size_t i; (i = _next++) < _cnt; )	(*_task)(i);
+	}
+	catch (...) {
+		lock_guard<mutex> lock(_mutex);
+		if (!_error)	_error = current_exception();
+		_next = _cnt;		// skip the rest indexes
+	}
+}
+
+void WorkerPool::Work()
+{
+	for (size_t runID = 0;;) {
+		{
+			unique_lock<mutex> lock(_mutex);
+			_cvTask.wait(lock, [&] { return _stop || _runID != runID; });
+			if (_stop)	return;
+			runID = _runID;
+		}
+		DoTasks();
+		{
+			lock_guard<mutex> lock(_mutex);
+			--_busyCnt;
+		}
+		_cvDone.notify_one();
+	}
+}
+
+void WorkerPool::Run(size_t cnt, const function<void(size_t)>& task)
+{
+	if (_threads.empty() || cnt == 1) {		// nothing to share
+		for (size_t i = 0; i < cnt; i++)	task(i);
+		return;
+	}
+	{
+		lock_guard<mutex> lock(_mutex);
+		_task = &task;
+		_cnt = cnt;
+		_next = 0;
+		_busyCnt = thrid(_threads.size());
+		_runID++;
+	}
+	_cvTask.notify_all();
+	DoTasks();
+
+	unique_lock<mutex> lock(_mutex);
+	_cvDone.wait(lock, [this] { return !_busyCnt; });
+	_task = nullptr;
+	if (_error) {
+		const exception_ptr error = _error;
+		_error = nullptr;
+		rethrow_exception(error);
+	}
+}
+
+/************************  end of class WorkerPool ************************/
 #endif	// _MULTITHREAD
 
 /************************ class Chrom ************************/
@@ -21,6 +21,9 @@ Last modified: 08/04/2024
 #include <chrono>
 #ifdef _MULTITHREAD
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
 #endif
 
 #ifdef __unix__
@@ -773,6 +776,45 @@ public:
 #endif
 } myMutex;
 
+#ifdef _MULTITHREAD
+// 'WorkerPool' calls indexed task on persistent threads.
+//	The caller's thread takes part in each run, so the pool of N threads keeps N-1 workers.
+class WorkerPool
+{
+	vector<thread>	_threads;
+	mutex			_mutex;
+	condition_variable _cvTask;		// signals about the new run or stopping
+	condition_variable _cvDone;		// signals that worker has completed the run
+	const function<void(size_t)>* _task = nullptr;	// current task
+	size_t			_cnt = 0;		// number of task indexes in the current run
+	atomic<size_t>	_next{ 0 };		// next task index
+	size_t			_runID = 0;		// current run ID
+	thrid			_busyCnt = 0;	// number of workers which have not completed the current run
+	bool			_stop = false;
+	exception_ptr	_error;			// first exception thrown by task in the current run
+
+	// Calls task for the free indexes while they are
+	void DoTasks();
+
+	// Waits for the runs and takes part in them until stopped
+	void Work();
+
+public:
+	// Creates new instance and launches workers
+	//	@param thrCnt: total number of threads, including the caller's one
+	WorkerPool(thrid thrCnt);
+
+	// Stops and joins workers
+	~WorkerPool();
+
+	// Calls task for each index from 0 to cnt-1 in parallel and waits for all calls to complete.
+	//	Rethrows the first exception thrown by task; the rest indexes are skipped in that case.
+	//	@param cnt: number of indexes
+	//	@param task: called function with index as parameter
+	void Run(size_t cnt, const function<void(size_t)>& task);
+};
+#endif	// _MULTITHREAD
+
 // 'Chrom' establishes correspondence between chromosome's ID and it's name.
 static class Chrom
 /**********************************************************************************
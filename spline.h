@@ -1,14 +1,14 @@
 /**********************************************************
 spline 2023 Fedor Naumenko (fedor.naumenko@gmail.com)
 -------------------------
-Last modified: 5/30/2024
+Last modified: 10/16/2026
 -------------------------
 Two-modes spline (smoothing curve) based in moving window
 ***********************************************************/
 #pragma once
 
 #include <vector>
-#include <algorithm>	// sort
+#include <algorithm>	// lower_bound, upper_bound
 #include <memory>		// unique_ptr
 
 enum eCurveType {
@@ -63,10 +63,12 @@ public:
 	}
 
 private:
-	// Moving window (Sliding subset)
+	// Moving window (Sliding subset) as a ring buffer
 	template<typename T>
 	class MW : protected std::vector<T>
 	{
+		size_t _first = 0;		// index of the first (oldest) value
+
 	protected:
 		MW() {}
 
@@ -74,10 +76,13 @@ private:
 		MW(slen_t base) { Init(base); }
 
 		// Adds last value and pops the first one (QUEUE functionality)
-		void PushVal(T val)
+		//	@returns: popped value
+		T PushVal(T val)
 		{
-			std::move(this->begin() + 1, this->end(), this->begin());
-			*(this->end() - 1) = val;
+			const T first = (*this)[_first];
+			(*this)[_first] = val;
+			if (++_first == this->size())	_first = 0;
+			return first;
 		}
 
 	public:
@@ -85,7 +90,7 @@ private:
 		//	@param base: half-length of moving window
 		void Init(slen_t base) { this->insert(this->begin(), size_t(base) * 2 + 1, 0); }
 
-		void Clear() { fill(this->begin(), this->end(), 0); }
+		void Clear() { fill(this->begin(), this->end(), 0); _first = 0; }
 	};
 
 	// Simple Moving Average spliner
@@ -101,8 +106,7 @@ private:
 		//	@param zeroOutput: if true than return 0 (silent zone)
 		float Push(T val, bool zeroOutput)
 		{
-			_sum += int64_t(val) - *this->begin();
-			this->PushVal(val);
+			_sum += int64_t(val) - this->PushVal(val);
 			return zeroOutput ? 0 : float(_sum) / this->size();
 		}
 
@@ -113,7 +117,7 @@ private:
 	template<typename T>
 	class MM : protected MW<T>
 	{
-		std::vector<T> _ss;		// sorted moving window (sliding subset)
+		std::vector<T> _ss;		// sorted moving window (sliding subset), updated by each pushed value
 
 	public:
 		// Constructor
@@ -125,11 +129,23 @@ private:
 		//	@param zeroOutput: if true than return 0 (silent zone)
 		T Push(T val, bool zeroOutput)
 		{
-			this->PushVal(val);
-			if (zeroOutput)	return 0;
-			std::copy(this->begin(), this->end(), _ss.begin());
-			std::sort(_ss.begin(), _ss.end());
-			return _ss[this->size() >> 1];		// mid-size
+			const T first = this->PushVal(val);
+
+			// replace popped value by the new one in the sorted window:
+			// only the values between them are shifted
+			if (val > first) {
+				const auto it = std::lower_bound(_ss.begin(), _ss.end(), first);
+				const auto itEnd = std::lower_bound(it + 1, _ss.end(), val);
+				std::move(it + 1, itEnd, it);
+				*(itEnd - 1) = val;
+			}
+			else if (val < first) {
+				const auto it = std::lower_bound(_ss.begin(), _ss.end(), first);
+				const auto itStart = std::upper_bound(_ss.begin(), it, val);
+				std::move_backward(itStart, it, it + 1);
+				*itStart = val;
+			}
+			return zeroOutput ? 0 : _ss[this->size() >> 1];		// mid-size
 		}
 
 		// Empty (stub) 'Push' method